@@ -0,0 +1,173 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a minimal affine transform (a 3x4 matrix) so
+// the matrices built by glRotated/glTranslated while drawing can
+// also be computed on the CPU, e.g., to find where bodies are
+// without rendering them.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef AFFINE_H_
+#define AFFINE_H_
+
+#include <math.h>
+#include "cglx.h"
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+/*
+ * Rotation in m[row * 4 + col] for col < 3, translation in column 3.
+ */
+struct Affine
+{
+    double m[12];
+
+
+    static Affine identity ()
+    {
+        Affine a = {{ 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0 }};
+        return a;
+    }
+
+
+    /*
+     * Same matrix as glRotated(degrees, x, y, z); identity if the axis
+     * has no length.
+     */
+    static Affine rotation (double degrees, double x, double y, double z)
+    {
+        double length = sqrt(x * x + y * y + z * z);
+        if (length == 0 || degrees == 0)
+        {
+            return identity();
+        }
+        return unitRotation(degrees, x / length, y / length, z / length);
+    }
+
+
+    /*
+     * Same as rotation() for an axis already of length 1 (or 0, for no
+     * rotation), so a fixed axis need only be normalized once.
+     */
+    static Affine unitRotation (double degrees, double x, double y, double z)
+    {
+        if (degrees == 0 || (x == 0 && y == 0 && z == 0))
+        {
+            return identity();
+        }
+        double radians = degrees * M_PI / 180.0;
+        return unitRotation(sin(radians), cos(radians), x, y, z);
+    }
+
+
+    /*
+     * Same as unitRotation() for an angle given by its sine and cosine,
+     * e.g., from sinCosDegrees().
+     */
+    static Affine unitRotation (double s, double c, double x, double y, double z)
+    {
+        if (x == 0 && y == 0 && z == 0)
+        {
+            return identity();
+        }
+        double t = 1 - c;
+        Affine a = {{ t * x * x + c,     t * x * y - s * z, t * x * z + s * y, 0,
+                      t * x * y + s * z, t * y * y + c,     t * y * z - s * x, 0,
+                      t * x * z - s * y, t * y * z + s * x, t * z * z + c,     0 }};
+        return a;
+    }
+
+
+    /*
+     * Returns this * other, i.e., other applied first, as OpenGL
+     * composes matrices.
+     */
+    Affine operator* (const Affine& other) const
+    {
+        Affine a;
+        for (int r = 0; r < 3; r++)
+        {
+            const double * row = m + 4 * r;
+            for (int c = 0; c < 4; c++)
+            {
+                a.m[4 * r + c] = row[0] * other.m[c] + row[1] * other.m[4 + c] +
+                                 row[2] * other.m[8 + c];
+            }
+            a.m[4 * r + 3] += row[3];
+        }
+        return a;
+    }
+
+
+    /*
+     * Same as multiplying on the right by glTranslated(x, y, z).
+     */
+    void translate (double x, double y, double z)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            m[4 * r + 3] += m[4 * r] * x + m[4 * r + 1] * y + m[4 * r + 2] * z;
+        }
+    }
+
+
+    /*
+     * Same as multiplying on the right by glRotated(degrees, 0, 1, 0),
+     * a turn within the xz plane.
+     */
+    void rotateY (double degrees)
+    {
+        double radians = degrees * M_PI / 180.0;
+        rotateY(sin(radians), cos(radians));
+    }
+
+
+    /*
+     * Same as rotateY() for an angle given by its sine and cosine.
+     */
+    void rotateY (double s, double c)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            double x = m[4 * r], z = m[4 * r + 2];
+            m[4 * r] = x * c - z * s;
+            m[4 * r + 2] = x * s + z * c;
+        }
+    }
+
+
+    /*
+     * Finds where this transform puts the point (x, y, z), the same as
+     * the translation of this times a translation by it.
+     */
+    void transformPoint (double x, double y, double z, double p[3]) const
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            p[r] = m[4 * r] * x + m[4 * r + 1] * y + m[4 * r + 2] * z + m[4 * r + 3];
+        }
+    }
+
+
+    /*
+     * Multiplies the current OpenGL matrix by this one.
+     */
+    void apply () const
+    {
+        GLdouble gl[16] = { m[0], m[4], m[8],  0,
+                            m[1], m[5], m[9],  0,
+                            m[2], m[6], m[10], 0,
+                            m[3], m[7], m[11], 1 };
+        glMultMatrixd(gl);
+    }
+
+
+    double getX () const { return m[3]; }
+    double getY () const { return m[7]; }
+    double getZ () const { return m[11]; }
+};
+
+#endif
@@ -0,0 +1,159 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file counts heap allocations made by each thread, by
+// replacing the global operator new and delete.  Reading the count
+// before and after some work (e.g., a frame phase, see
+// frame_profiler.h) tells how often that work allocated, so a
+// steady-state frame can be kept from allocating at all: allocations
+// on the render path show up as tail latency on the wall.
+//
+// Like the other globals here, the replacements are defined in this
+// header, so it must be included by exactly one file per program.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef ALLOC_COUNTER_H_
+#define ALLOC_COUNTER_H_
+
+#include <cstddef>
+#include <cstdlib>           // for malloc, aligned_alloc
+#include <new>
+
+/*
+ * Allocations made by one thread since it started.
+ */
+struct AllocationCount
+{
+    long allocations;
+    long bytes;
+};
+
+// this thread's allocations
+thread_local AllocationCount theThreadAllocations = { 0, 0 };
+
+
+/*
+ * Returns how many allocations this thread has made so far.
+ */
+inline long countAllocations ()
+{
+    return theThreadAllocations.allocations;
+}
+
+
+/*
+ * Returns memory from malloc, counted against this thread, or NULL.
+ */
+inline void * countedAllocate (size_t bytes, size_t alignment = 0)
+{
+    theThreadAllocations.allocations++;
+    theThreadAllocations.bytes += bytes;
+    if (bytes == 0)
+    {
+        bytes = 1;
+    }
+    if (alignment > alignof(std::max_align_t))
+    {
+        // aligned_alloc wants a multiple of the alignment
+        return aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+    }
+    return malloc(bytes);
+}
+
+
+/*
+ * Returns memory from countedAllocate() to malloc.  Kept out of line,
+ * or the compiler pairs the free() with operator new and warns.
+ */
+__attribute__((noinline)) void countedFree (void * p)
+{
+    free(p);
+}
+
+
+//////////////////////////////////////////////////////////////////
+// Replacements of the global allocation functions
+//
+void * operator new (size_t bytes)
+{
+    void * p = countedAllocate(bytes);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[] (size_t bytes)
+{
+    return operator new(bytes);
+}
+
+void * operator new (size_t bytes, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(bytes);
+}
+
+void * operator new[] (size_t bytes, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(bytes);
+}
+
+void * operator new (size_t bytes, std::align_val_t alignment)
+{
+    void * p = countedAllocate(bytes, size_t(alignment));
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[] (size_t bytes, std::align_val_t alignment)
+{
+    return operator new(bytes, alignment);
+}
+
+void operator delete (void * p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[] (void * p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete (void * p, size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[] (void * p, size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete (void * p, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[] (void * p, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete (void * p, size_t, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[] (void * p, size_t, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+#endif
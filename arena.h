@@ -0,0 +1,177 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines an arena: memory handed out from a few large
+// blocks and given back all at once, for objects that live exactly as
+// long as their owner (e.g., a catalog's bodies).  Blocks double in
+// size as the arena grows, so a million bodies take a few dozen
+// allocations rather than millions, sit next to each other in memory,
+// and are freed without walking them.
+//
+// An arena never runs destructors; its owner destroys what it created
+// before release().
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdlib>           // for malloc
+#include <new>               // for placement new, bad_alloc
+#include <utility>           // for forward
+#include <vector>
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class Arena
+{
+  public:
+    // size of the first block; each later one is twice the last
+    static const size_t FIRST_BLOCK_SIZE = 64 * 1024;
+    // blocks stop doubling at this size
+    static const size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;
+
+
+    Arena ()
+      : myNext(NULL),
+        myEnd(NULL),
+        myLastSize(0),
+        myCapacity(0),
+        myUsed(0)
+    {
+    }
+
+
+    ~Arena ()
+    {
+        release();
+    }
+
+
+    /*
+     * Returns bytes of memory aligned to the given power of two, which
+     * stays valid until release().
+     */
+    void * allocate (size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        char * start = align(myNext, alignment);
+        if (myNext == NULL || start + bytes > myEnd)
+        {
+            grow(bytes + alignment);
+            start = align(myNext, alignment);
+        }
+        myNext = start + bytes;
+        myUsed += bytes;
+        return start;
+    }
+
+
+    /*
+     * Constructs a T in the arena from the given arguments.
+     */
+    template <typename T, typename... Args>
+    T * create (Args&&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+
+    /*
+     * Returns an uninitialized array of count Ts, for types that need
+     * no constructor (e.g., pointers).
+     */
+    template <typename T>
+    T * allocateArray (size_t count)
+    {
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+
+    /*
+     * Frees every block at once.
+     */
+    void release ()
+    {
+        for (size_t k = 0; k < myBlocks.size(); k++)
+        {
+            free(myBlocks[k]);
+        }
+        myBlocks.clear();
+        myNext = myEnd = NULL;
+        myLastSize = myCapacity = myUsed = 0;
+    }
+
+
+    /*
+     * Returns the bytes of every block, and of those the bytes handed
+     * out (without alignment padding).
+     */
+    size_t getCapacity () const
+    {
+        return myCapacity;
+    }
+
+
+    size_t getUsed () const
+    {
+        return myUsed;
+    }
+
+
+    int getBlockCount () const
+    {
+        return int(myBlocks.size());
+    }
+
+
+    // copies would free the blocks twice
+    Arena (const Arena&) = delete;
+    Arena& operator= (const Arena&) = delete;
+
+
+  private:
+    static char * align (char * p, size_t alignment)
+    {
+        return (char *)(((size_t)p + alignment - 1) & ~(alignment - 1));
+    }
+
+
+    /*
+     * Starts a new block with room for at least the given bytes.
+     */
+    void grow (size_t bytes)
+    {
+        size_t size = (myLastSize == 0) ? FIRST_BLOCK_SIZE : myLastSize * 2;
+        if (size > MAX_BLOCK_SIZE)
+        {
+            size = MAX_BLOCK_SIZE;
+        }
+        if (size < bytes)
+        {
+            size = bytes;
+        }
+        char * block = (char *)malloc(size);
+        if (block == NULL)
+        {
+            throw std::bad_alloc();
+        }
+        myBlocks.push_back(block);
+        myNext = block;
+        myEnd = block + size;
+        myLastSize = size;
+        myCapacity += size;
+    }
+
+
+    std::vector<char *> myBlocks;
+    char * myNext;
+    char * myEnd;
+    size_t myLastSize;
+    size_t myCapacity;
+    size_t myUsed;
+};
+
+#endif
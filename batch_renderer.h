@@ -0,0 +1,1086 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a renderer that draws the same wireframes as
+// SolarSystem::draw(), but sorted by what they look like instead of
+// walking the orbit tree.  Bodies are grouped by kind once, when a
+// catalog is loaded; each frame the meshes of a group are moved into
+// place on the CPU and sent as a few large batches, with the color
+// and vertex array set once per group instead of once per body (or,
+// as transform() does, once per ancestor of every body).
+//
+// What a kind looks like is fixed at compile time by KindTraits, so
+// drawing a group needs no virtual calls.
+//
+// Bodies whose satellites would all fit within a few pixels (a
+// planet and its moons, seen from far away) are drawn as impostors:
+// the satellites and their orbits are left out and replaced by one
+// point each, from a cached cloud that follows the body and is only
+// rebuilt when the camera's distance changes enough or it gets old.
+//
+// Bodies (with their satellites, where possible) entirely behind one
+// of the few spheres largest on screen can be left out too; each of
+// those spheres is treated as solid, as the cone from the eye that
+// holds it.  Spheres are drawn as wireframes, which hide nothing, so
+// this is off unless toggleOcclusion() turns it on.
+//
+// Bodies out of view are left out as well.  Culling walks down from
+// each orbit center, testing what orbits it against the view before
+// finding where it is, so the world positions of bodies far out of
+// view (and of satellites hidden in an impostor) are never found.
+//
+// Vertices are made relative to the eye in double before they become
+// float, so a catalog far from the world origin draws without jitter.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef BATCH_RENDERER_H_
+#define BATCH_RENDERER_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>         // for min, max
+#include "cglx.h"
+#include "solar_system.h"
+#include "space_objects.h"
+#include "body_state.h"
+#include "geometry.h"
+#include "vector_math.h"
+#include "affine.h"
+#include "sincos.h"
+#include "memory_report.h"
+#include "trace.h"
+
+using namespace std;
+
+/*
+ * How each kind of body is drawn: its color, sphere resolution,
+ * whether its orbit is drawn (as SpaceObject::drawOrbit() would) and
+ * how many ticks its trail shows by default.
+ */
+template <BodyKind KIND>
+struct KindTraits;
+
+template <>
+struct KindTraits<KIND_SUN>
+{
+    static const int SLICES = 20;
+    static const int STACKS = 20;
+    static const int TRAIL_LENGTH = 0;
+    static const bool HAS_ORBIT = false;
+    static const Color& color () { return Sun::SUN_COLOR; }
+};
+
+template <>
+struct KindTraits<KIND_PLANET>
+{
+    static const int SLICES = 20;
+    static const int STACKS = 20;
+    static const int TRAIL_LENGTH = 120;
+    static const bool HAS_ORBIT = true;
+    static const Color& color () { return Planet::PLANET_COLOR; }
+};
+
+template <>
+struct KindTraits<KIND_MOON>
+{
+    static const int SLICES = 20;
+    static const int STACKS = 20;
+    static const int TRAIL_LENGTH = 30;
+    static const bool HAS_ORBIT = true;
+    static const Color& color () { return Moon::MOON_COLOR; }
+};
+
+
+/*
+ * OpenGL work issued for one or more frames.
+ */
+struct DrawStats
+{
+    long drawCalls;
+    long stateChanges;
+    // subtrees drawn as impostors
+    long impostors;
+    // bodies left out because larger spheres hide them
+    long occluded;
+
+
+    DrawStats ()
+      : drawCalls(0),
+        stateChanges(0),
+        impostors(0),
+        occluded(0)
+    {
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class BatchRenderer
+{
+  private:
+    // what does not change after loading, per body in catalog order
+    struct BodyInfo
+    {
+        // the body's constant frames (see SpaceObject::updateFrames())
+        Vector3 spinAxis;
+        Affine orbitFrame;
+        double size;
+        double distance;
+        // catalog position of the orbit center, or -1
+        int center;
+        // orbit centers above the body
+        int depth;
+        // radius of a sphere around the body holding all its satellites
+        double bound;
+        // and one holding every vertex drawn for them and their orbits
+        double reach;
+        BodyKind kind;
+    };
+
+    /*
+     * A sphere large on screen, as a cone from the eye (in eye space).
+     */
+    struct Occluder
+    {
+        int body;
+        double pixels;
+        double direction[3];
+        double halfAngle;
+        // farthest the cone's edge travels before entering the sphere
+        double entryDistance;
+    };
+
+    /*
+     * A cloud of points standing in for a body's satellites, as offsets
+     * from the body's center (kept in View::offsets).
+     */
+    struct Impostor
+    {
+        bool isBuilt;
+        uint64_t tick;
+        double depth;
+    };
+
+    /*
+     * What each drawing thread keeps between frames: which bodies its
+     * view leaves out, its occluders, its impostors and the points
+     * drawn for them.
+     */
+    struct View
+    {
+        unsigned int generation;
+        // whether cull() has run since the last draw
+        bool isCulled;
+        // HIDE_* and IN_VIEW flags per body
+        vector<unsigned char> isHidden;
+        vector<Occluder> occluders;
+        long numOccluded;
+        vector<Impostor> impostors;
+        // every impostor's offsets, for body k from myOffsetStarts[k]
+        vector<GLfloat> offsets;
+        vector<int> collapsed;
+        vector<GLfloat> points;
+        vector<GLfloat> colors;
+        // world position drawn at the modelview's origin (the eye)
+        double origin[3];
+        // the center in eye coordinates of each body cull() found
+        // in view
+        vector<double> eyeX, eyeY, eyeZ;
+
+
+        View ()
+          : generation(0),
+            isCulled(false),
+            numOccluded(0)
+        {
+            origin[0] = origin[1] = origin[2] = 0;
+        }
+    };
+
+    vector<BodyInfo> myBodies;
+    // satellites, and theirs, of each body that has any
+    vector< vector<int> > myDescendants;
+    // where each body's impostor offsets start in View::offsets
+    vector<size_t> myOffsetStarts;
+    GLfloat myKindColors[NUM_BODY_KINDS][3];
+    // changes whenever bodies are set, so views know to start over
+    unsigned int myGeneration;
+    bool isLOD;
+    bool isOcclusion;
+    // catalog positions of each kind's bodies
+    vector<int> myGroups[NUM_BODY_KINDS];
+    WireMesh mySpheres[NUM_BODY_KINDS];
+    // unit circle drawn the way wireTorus(d, d, 100, 1) draws orbits
+    WireMesh myOrbit;
+    // farthest a vertex of each mesh gets from where it is centered
+    double mySphereReach[NUM_BODY_KINDS];
+    double myOrbitReach;
+    // work issued since the last takeStats(), from every thread
+    atomic<long> myNumDrawCalls;
+    atomic<long> myNumStateChanges;
+    atomic<long> myNumImpostors;
+    atomic<long> myNumOccluded;
+
+    /*
+     * Keeps a kind's color as glColor3d would clamp it.
+     */
+    void setKindColor (BodyKind kind, const Color& color)
+    {
+        myKindColors[kind][0] = GLfloat(max(0.0, min(color.r, 1.0)));
+        myKindColors[kind][1] = GLfloat(max(0.0, min(color.g, 1.0)));
+        myKindColors[kind][2] = GLfloat(max(0.0, min(color.b, 1.0)));
+    }
+
+    /*
+     * Collects transformed vertices and draws them in batches of at
+     * most MAX_BATCH_VERTICES.  Each drawing thread has its own.
+     */
+    struct Batch
+    {
+        vector<GLfloat> vertices;
+        int count;
+        int drawCalls;
+        // a group's bodies in view, their spin angles, and the angles'
+        // sines and cosines
+        vector<int> bodies;
+        vector<double> angles, sines, cosines;
+
+
+        Batch ()
+          : vertices(3 * MAX_BATCH_VERTICES),
+            count(0),
+            drawCalls(0)
+        {
+        }
+
+
+        void add (const WireMesh& mesh, const Affine& m)
+        {
+            const GLfloat * in = mesh.getVertices();
+            int total = mesh.getVertexCount();
+            for (int done = 0; done < total; )
+            {
+                if (count == MAX_BATCH_VERTICES)
+                {
+                    flush();
+                }
+                int n = min(total - done, MAX_BATCH_VERTICES - count);
+                const GLfloat * v = in + 3 * done;
+                GLfloat * out = &vertices[3 * count];
+                for (int k = 0; k < n; k++, v += 3, out += 3)
+                {
+                    out[0] = GLfloat(m.m[0] * v[0] + m.m[1] * v[1] + m.m[2] * v[2] + m.m[3]);
+                    out[1] = GLfloat(m.m[4] * v[0] + m.m[5] * v[1] + m.m[6] * v[2] + m.m[7]);
+                    out[2] = GLfloat(m.m[8] * v[0] + m.m[9] * v[1] + m.m[10] * v[2] + m.m[11]);
+                }
+                count += n;
+                done += n;
+            }
+        }
+
+
+        void flush ()
+        {
+            if (count > 0)
+            {
+                glDrawArrays(GL_LINES, 0, count);
+                drawCalls++;
+                count = 0;
+            }
+        }
+    };
+
+    static Batch& getBatch ()
+    {
+        static thread_local Batch theBatch;
+        return theBatch;
+    }
+
+    static View& getThreadView ()
+    {
+        static thread_local View theView;
+        return theView;
+    }
+
+    /*
+     * Returns this thread's view, set up for the current catalog.
+     */
+    View& getView ()
+    {
+        View& view = getThreadView();
+        if (view.generation != myGeneration)
+        {
+            view.generation = myGeneration;
+            view.isHidden.assign(myBodies.size(), 0);
+            view.impostors.assign(myBodies.size(), Impostor());
+            view.offsets.assign(myOffsetStarts.back(), 0);
+            view.collapsed.clear();
+            view.eyeX.assign(myBodies.size(), 0);
+            view.eyeY.assign(myBodies.size(), 0);
+            view.eyeZ.assign(myBodies.size(), 0);
+            // full size up front, so frames do not allocate once warm
+            view.collapsed.reserve(myBodies.size());
+            view.occluders.reserve(MAX_OCCLUDERS);
+            view.points.reserve(3 * myBodies.size());
+            view.colors.reserve(3 * myBodies.size());
+        }
+        return view;
+    }
+
+    static unsigned int nextGeneration ()
+    {
+        static atomic<unsigned int> theGeneration(0);
+        return ++theGeneration;
+    }
+
+    /*
+     * Returns true if a sphere of the given radius around eye-space
+     * point c is entirely hidden by the occluder: inside the cone from
+     * the eye that just holds the occluder, and farther than anywhere
+     * the cone enters it.
+     */
+    static bool isOccluded (const Occluder& occluder, const double c[3], double radius)
+    {
+        double distance = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+        if (distance - radius < occluder.entryDistance)
+        {
+            return false;
+        }
+        double cosine = (c[0] * occluder.direction[0] + c[1] * occluder.direction[1] +
+                         c[2] * occluder.direction[2]) / distance;
+        double angle = acos(max(-1.0, min(cosine, 1.0)));
+        return angle + asin(radius / distance) <= occluder.halfAngle;
+    }
+
+    bool isOccluded (const View& view, const double c[3], double radius, int body) const
+    {
+        for (size_t k = 0; k < view.occluders.size(); k++)
+        {
+            if (view.occluders[k].body != body && isOccluded(view.occluders[k], c, radius))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * Keeps the body, at eye-space point c, among the MAX_OCCLUDERS
+     * bodies largest on screen, largest first, if it is one.
+     */
+    void addOccluder (View& view, int body, const double c[3], double focalLength)
+    {
+        double radius = myBodies[body].size;
+        double distance = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+        // only bodies in front of the eye, which it is not inside
+        if (-c[2] <= radius || distance <= radius)
+        {
+            return;
+        }
+        double pixels = radius * focalLength / -c[2];
+        if (pixels < MIN_OCCLUDER_PIXELS ||
+            (int(view.occluders.size()) == MAX_OCCLUDERS && pixels <= view.occluders.back().pixels))
+        {
+            return;
+        }
+        Occluder occluder;
+        occluder.body = body;
+        occluder.pixels = pixels;
+        for (int a = 0; a < 3; a++)
+        {
+            occluder.direction[a] = c[a] / distance;
+        }
+        occluder.halfAngle = asin(radius / distance);
+        occluder.entryDistance = sqrt(distance * distance - radius * radius);
+        if (int(view.occluders.size()) == MAX_OCCLUDERS)
+        {
+            view.occluders.pop_back();
+        }
+        size_t at = view.occluders.size();
+        while (at > 0 && view.occluders[at - 1].pixels < pixels)
+        {
+            at--;
+        }
+        view.occluders.insert(view.occluders.begin() + at, occluder);
+    }
+
+    /*
+     * Finds the left, right, bottom and top planes of the projection's
+     * frustum in eye space, each as a unit normal pointing in and an
+     * offset.  The near and far planes are left out, as depth may be
+     * reversed (see frustum.h); the sides alone still leave out
+     * everything behind the eye.
+     */
+    static void findFrustum (const double projection[16], double planes[4][4])
+    {
+        for (int p = 0; p < 4; p++)
+        {
+            // the last row of the projection plus or minus its first
+            // (left and right) or second (bottom and top)
+            int row = p / 2;
+            double sign = (p % 2 == 0) ? 1 : -1;
+            for (int a = 0; a < 4; a++)
+            {
+                planes[p][a] = projection[4 * a + 3] + sign * projection[4 * a + row];
+            }
+            double length = sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] +
+                                 planes[p][2] * planes[p][2]);
+            for (int a = 0; a < 4; a++)
+            {
+                planes[p][a] /= length;
+            }
+        }
+    }
+
+    /*
+     * Returns true if a sphere of the given radius around eye-space
+     * point c is entirely outside one of the frustum's planes, by more
+     * than rounding its vertices to float could move them.
+     */
+    static bool isOutside (const double planes[4][4], const double c[3], double radius)
+    {
+        double slack = radius + FRUSTUM_SLACK * (fabs(c[0]) + fabs(c[1]) + fabs(c[2]));
+        for (int p = 0; p < 4; p++)
+        {
+            if (planes[p][0] * c[0] + planes[p][1] * c[1] + planes[p][2] * c[2] + planes[p][3] < -slack)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * Returns true if the body, at eye-space point c, has satellites
+     * that would all fit within IMPOSTOR_PIXELS.
+     */
+    bool isSmall (int body, const double c[3], double focalLength) const
+    {
+        const BodyInfo& info = myBodies[body];
+        double depth = -c[2];
+        return ! myDescendants[body].empty() && depth > info.bound &&
+               info.bound * focalLength / depth < IMPOSTOR_PIXELS;
+    }
+
+    /*
+     * Decides, for the current modelview and projection, which bodies
+     * are out of view, which are hidden behind the largest spheres on
+     * screen and which are drawn as impostors (hiding their
+     * satellites), and rebuilds impostors that have gone stale.
+     */
+    void cull (SolarSystem& system, View& view)
+    {
+        TRACE_SCOPE("BatchRenderer::cull");
+        view.collapsed.clear();
+        view.occluders.clear();
+        view.numOccluded = 0;
+        GLdouble modelview[16], projection[16];
+        GLint viewport[4];
+        glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+        glGetDoublev(GL_PROJECTION_MATRIX, projection);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        // pixels per unit of size at unit depth
+        double focalLength = projection[5] * viewport[3] / 2;
+        double planes[4][4];
+        findFrustum(projection, planes);
+        // accurate enough to cull with, even for eyes far from the origin
+        Matrix4 toEye = Matrix4(modelview) *
+                        Matrix4::translation(-view.origin[0], -view.origin[1], -view.origin[2]);
+
+        // first, orbit centers before what orbits them, the bodies in
+        // view and where they are; a body is only found if it may be in
+        // view from where its center is, and its satellites only if it
+        // is too large to be an impostor
+        for (size_t k = 0; k < myBodies.size(); k++)
+        {
+            const BodyInfo& info = myBodies[k];
+            unsigned char hidden = 0;
+            if (info.center >= 0)
+            {
+                if ((view.isHidden[info.center] & HIDE_SATELLITES) != 0)
+                {
+                    view.isHidden[k] = HIDE_ALL;
+                    continue;
+                }
+                // the orbit circles the center, and the body and what
+                // orbits it stay within its distance and reach of that
+                double center[3] = { view.eyeX[info.center], view.eyeY[info.center], view.eyeZ[info.center] };
+                if (isOutside(planes, center, info.distance * myOrbitReach))
+                {
+                    hidden |= HIDE_ORBIT;
+                }
+                if (isOutside(planes, center, info.distance + info.reach))
+                {
+                    view.isHidden[k] = hidden | HIDE_SPHERE | HIDE_SATELLITES;
+                    continue;
+                }
+            }
+            const Affine& world = system.getWorld(int(k));
+            Point3 p = toEye.transformPoint(Point3(world.getX(), world.getY(), world.getZ()));
+            double c[3] = { p.x, p.y, p.z };
+            if (isOutside(planes, c, info.reach))
+            {
+                view.isHidden[k] = hidden | HIDE_SPHERE | HIDE_SATELLITES;
+                continue;
+            }
+            view.eyeX[k] = c[0];
+            view.eyeY[k] = c[1];
+            view.eyeZ[k] = c[2];
+            hidden |= IN_VIEW;
+            if (isOutside(planes, c, info.size * mySphereReach[info.kind]))
+            {
+                hidden |= HIDE_SPHERE;
+            }
+            else if (isOcclusion)
+            {
+                // spheres out of view cannot hide anything in it
+                addOccluder(view, int(k), c, focalLength);
+            }
+            if (isLOD && isSmall(int(k), c, focalLength))
+            {
+                hidden |= HIDE_SATELLITES;
+            }
+            view.isHidden[k] = hidden;
+        }
+        if (view.occluders.empty() && ! isLOD)
+        {
+            view.isCulled = true;
+            return;
+        }
+
+        // then, of those, which larger spheres hide and which are
+        // drawn as impostors
+        for (size_t k = 0; k < myBodies.size(); k++)
+        {
+            const BodyInfo& info = myBodies[k];
+            if (info.center >= 0 && (view.isHidden[info.center] & HIDE_SATELLITES) != 0)
+            {
+                // hidden with an orbit center
+                view.isHidden[k] = HIDE_ALL;
+                continue;
+            }
+            if ((view.isHidden[k] & IN_VIEW) == 0)
+            {
+                continue;
+            }
+            double c[3] = { view.eyeX[k], view.eyeY[k], view.eyeZ[k] };
+            if (! myDescendants[k].empty() && isOccluded(view, c, info.bound, int(k)))
+            {
+                // its orbit circles its own center, so may still show
+                view.isHidden[k] |= HIDE_SPHERE | HIDE_SATELLITES;
+                view.numOccluded += 1 + long(myDescendants[k].size());
+                continue;
+            }
+            if ((view.isHidden[k] & HIDE_SPHERE) == 0 && isOccluded(view, c, info.size, int(k)))
+            {
+                view.isHidden[k] |= HIDE_SPHERE;
+                view.numOccluded++;
+            }
+            if (! isLOD || ! isSmall(int(k), c, focalLength))
+            {
+                continue;
+            }
+            view.collapsed.push_back(int(k));
+            double depth = -c[2];
+            Impostor& impostor = view.impostors[k];
+            if (! impostor.isBuilt || system.getTick() - impostor.tick >= IMPOSTOR_MAX_AGE ||
+                fabs(depth / impostor.depth - 1) > IMPOSTOR_DEPTH_CHANGE)
+            {
+                buildImpostor(system, int(k), depth, view);
+            }
+        }
+        view.isCulled = true;
+    }
+
+    void buildImpostor (SolarSystem& system, int body, double depth, View& view)
+    {
+        const Affine& center = system.getWorld(body);
+        const vector<int>& members = myDescendants[body];
+        GLfloat * offsets = &view.offsets[myOffsetStarts[body]];
+        for (size_t m = 0; m < members.size(); m++)
+        {
+            const Affine& world = system.getWorld(members[m]);
+            offsets[3 * m] = GLfloat(world.getX() - center.getX());
+            offsets[3 * m + 1] = GLfloat(world.getY() - center.getY());
+            offsets[3 * m + 2] = GLfloat(world.getZ() - center.getZ());
+        }
+        Impostor& impostor = view.impostors[body];
+        impostor.isBuilt = true;
+        impostor.tick = system.getTick();
+        impostor.depth = depth;
+    }
+
+    /*
+     * Draws every impostor of the view as points, in one draw call.
+     */
+    void drawImpostors (SolarSystem& system, View& view, DrawStats& stats)
+    {
+        if (view.collapsed.empty())
+        {
+            return;
+        }
+        view.points.clear();
+        view.colors.clear();
+        for (size_t c = 0; c < view.collapsed.size(); c++)
+        {
+            int body = view.collapsed[c];
+            const Affine& world = system.getWorld(body);
+            const vector<int>& members = myDescendants[body];
+            const GLfloat * offsets = &view.offsets[myOffsetStarts[body]];
+            for (size_t m = 0; m < members.size(); m++)
+            {
+                view.points.push_back(GLfloat(world.getX() - view.origin[0] + offsets[3 * m]));
+                view.points.push_back(GLfloat(world.getY() - view.origin[1] + offsets[3 * m + 1]));
+                view.points.push_back(GLfloat(world.getZ() - view.origin[2] + offsets[3 * m + 2]));
+                const GLfloat * color = myKindColors[myBodies[members[m]].kind];
+                view.colors.insert(view.colors.end(), color, color + 3);
+            }
+        }
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(3, GL_FLOAT, 0, &view.colors[0]);
+        glVertexPointer(3, GL_FLOAT, 0, &view.points[0]);
+        glDrawArrays(GL_POINTS, 0, GLsizei(view.points.size() / 3));
+        stats.drawCalls++;
+        glDisableClientState(GL_COLOR_ARRAY);
+        stats.stateChanges += 4;
+        stats.impostors += long(view.collapsed.size());
+    }
+
+    /*
+     * Scales an affine transform uniformly, as glScaled would.
+     */
+    static void scale (Affine& a, double s)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            a.m[4 * r] *= s;
+            a.m[4 * r + 1] *= s;
+            a.m[4 * r + 2] *= s;
+        }
+    }
+
+    static void setOrigin (View& view, const Point3& origin)
+    {
+        view.origin[0] = origin.x;
+        view.origin[1] = origin.y;
+        view.origin[2] = origin.z;
+    }
+
+    static bool isOrigin (const View& view, const Point3& origin)
+    {
+        return view.origin[0] == origin.x && view.origin[1] == origin.y && view.origin[2] == origin.z;
+    }
+
+    /*
+     * Moves an affine transform by -origin, in double, so what it
+     * places near the eye keeps its precision once made float.
+     */
+    static void relative (Affine& a, const double origin[3])
+    {
+        a.m[3] -= origin[0];
+        a.m[7] -= origin[1];
+        a.m[11] -= origin[2];
+    }
+
+    /*
+     * Draws every body of one kind in view with a single color and as
+     * few draw calls as its vertices allow.
+     */
+    template <BodyKind KIND>
+    void drawGroup (SolarSystem& system, const View& view, Batch& batch, DrawStats& stats)
+    {
+        const vector<int>& group = myGroups[KIND];
+        if (group.empty())
+        {
+            return;
+        }
+        const Color& color = KindTraits<KIND>::color();
+        glColor3d(color.r, color.g, color.b);
+        glVertexPointer(3, GL_FLOAT, 0, &batch.vertices[0]);
+        stats.stateChanges += 2;
+
+        batch.bodies.resize(group.size());
+        batch.angles.resize(group.size());
+        batch.sines.resize(group.size());
+        batch.cosines.resize(group.size());
+        int count = 0;
+        for (size_t k = 0; k < group.size(); k++)
+        {
+            int b = group[k];
+            if ((view.isHidden[b] & HIDE_SPHERE) == 0)
+            {
+                batch.bodies[count] = b;
+                batch.angles[count] = system.getRotationAngle(b);
+                count++;
+            }
+        }
+        sinCosDegrees(&batch.angles[0], count, &batch.sines[0], &batch.cosines[0],
+                      system.getSinCosAccuracy());
+        for (int k = 0; k < count; k++)
+        {
+            int b = batch.bodies[k];
+            const BodyInfo& info = myBodies[b];
+            Affine m = system.getWorld(b) *
+                       Affine::unitRotation(batch.sines[k], batch.cosines[k], info.spinAxis.x,
+                                            info.spinAxis.y, info.spinAxis.z);
+            scale(m, info.size);
+            relative(m, view.origin);
+            batch.add(mySpheres[KIND], m);
+        }
+        batch.flush();
+    }
+
+    /*
+     * Draws the orbits of every kind that has them, in white.
+     */
+    void drawOrbits (SolarSystem& system, const View& view, Batch& batch, DrawStats& stats)
+    {
+        glColor3d(1, 1, 1);
+        glVertexPointer(3, GL_FLOAT, 0, &batch.vertices[0]);
+        stats.stateChanges += 2;
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            if (! hasOrbit(BodyKind(kind)))
+            {
+                continue;
+            }
+            const vector<int>& group = myGroups[kind];
+            for (size_t k = 0; k < group.size(); k++)
+            {
+                const BodyInfo& info = myBodies[group[k]];
+                if (info.center < 0 || info.distance == 0 ||
+                    (view.isHidden[group[k]] & HIDE_ORBIT) != 0)
+                {
+                    continue;
+                }
+                Affine m = system.getWorld(info.center) * info.orbitFrame;
+                m.translate(-info.distance, 0, 0);
+                scale(m, info.distance);
+                relative(m, view.origin);
+                batch.add(myOrbit, m);
+            }
+        }
+        batch.flush();
+    }
+
+  public:
+    // vertices sent per draw call at most
+    static const int MAX_BATCH_VERTICES = 65536;
+    // satellites are drawn as impostors if they all fit within this radius
+    static constexpr double IMPOSTOR_PIXELS = 6;
+    // impostors are rebuilt if the camera's distance changes by this much
+    static constexpr double IMPOSTOR_DEPTH_CHANGE = 0.25;
+    // or after this many ticks, so satellites do not stop moving
+    static const uint64_t IMPOSTOR_MAX_AGE = 25;
+    // largest spheres on screen that other bodies are tested against
+    static const int MAX_OCCLUDERS = 4;
+    // and the smallest radius, in pixels, worth testing against
+    static constexpr double MIN_OCCLUDER_PIXELS = 16;
+    // what cull() leaves out of a body
+    static const unsigned char HIDE_SPHERE = 1;
+    static const unsigned char HIDE_ORBIT = 2;
+    // its satellites, at any depth, with their orbits
+    static const unsigned char HIDE_SATELLITES = 4;
+    static const unsigned char HIDE_ALL = HIDE_SPHERE | HIDE_ORBIT | HIDE_SATELLITES;
+    // and whether it is in view, its eye position found
+    static const unsigned char IN_VIEW = 8;
+    // share of its distance from the eye a body must be out of view by
+    static constexpr double FRUSTUM_SLACK = 1e-5;
+
+
+    BatchRenderer ()
+      : myOffsetStarts(1, 0),
+        myGeneration(nextGeneration()),
+        isLOD(true),
+        isOcclusion(false),
+        myNumDrawCalls(0),
+        myNumStateChanges(0),
+        myNumImpostors(0),
+        myNumOccluded(0)
+    {
+        setKindColor(KIND_SUN, KindTraits<KIND_SUN>::color());
+        setKindColor(KIND_PLANET, KindTraits<KIND_PLANET>::color());
+        setKindColor(KIND_MOON, KindTraits<KIND_MOON>::color());
+        mySpheres[KIND_SUN].buildSphere(KindTraits<KIND_SUN>::SLICES, KindTraits<KIND_SUN>::STACKS);
+        mySpheres[KIND_PLANET].buildSphere(KindTraits<KIND_PLANET>::SLICES, KindTraits<KIND_PLANET>::STACKS);
+        mySpheres[KIND_MOON].buildSphere(KindTraits<KIND_MOON>::SLICES, KindTraits<KIND_MOON>::STACKS);
+        myOrbit.buildTorus(1, 1, 100, 1);
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            mySphereReach[kind] = getReach(mySpheres[kind], 0);
+        }
+        // the circle is centered where the orbit is moved back by
+        myOrbitReach = getReach(myOrbit, 1);
+    }
+
+
+    /*
+     * Returns the farthest any vertex of the mesh is from (x, 0, 0).
+     */
+    static double getReach (const WireMesh& mesh, double x)
+    {
+        const GLfloat * v = mesh.getVertices();
+        double reach = 0;
+        for (int k = 0; k < mesh.getVertexCount(); k++, v += 3)
+        {
+            reach = max(reach, sqrt((v[0] - x) * (v[0] - x) + v[1] * v[1] + v[2] * v[2]));
+        }
+        return reach;
+    }
+
+
+    static bool hasOrbit (BodyKind kind)
+    {
+        switch (kind)
+        {
+          case KIND_SUN:
+            return KindTraits<KIND_SUN>::HAS_ORBIT;
+          case KIND_PLANET:
+            return KindTraits<KIND_PLANET>::HAS_ORBIT;
+          case KIND_MOON:
+            return KindTraits<KIND_MOON>::HAS_ORBIT;
+          default:
+            return false;
+        }
+    }
+
+
+    /*
+     * Sorts the given catalog's bodies into groups; call again whenever
+     * a catalog is loaded.
+     */
+    void setBodies (SolarSystem * system)
+    {
+        int count = system->getBodyCount();
+        myBodies.resize(count);
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            myGroups[kind].clear();
+        }
+        for (int k = 0; k < count; k++)
+        {
+            SpaceObject * body = system->getBody(k);
+            BodyInfo& info = myBodies[k];
+            info.spinAxis = body->getSpinAxis();
+            info.size = body->getSize();
+            info.orbitFrame = body->getOrbitFrame();
+            info.distance = body->getDistance();
+            info.center = (body->getOrbitCenter() == NULL) ? -1 : body->getOrbitCenter()->getIndex();
+            info.depth = (info.center < 0) ? 0 : myBodies[info.center].depth + 1;
+            info.bound = info.size;
+            info.kind = body->getKind();
+            info.reach = info.size * mySphereReach[info.kind];
+            myGroups[info.kind].push_back(k);
+        }
+
+        // satellites come after their orbit centers, so walking back
+        // finds each bound before it is needed
+        for (int k = count - 1; k >= 0; k--)
+        {
+            int center = myBodies[k].center;
+            if (center >= 0)
+            {
+                myBodies[center].bound = max(myBodies[center].bound,
+                                             myBodies[k].distance + myBodies[k].bound);
+                myBodies[center].reach = max(myBodies[center].reach,
+                                             max(myBodies[k].distance * myOrbitReach,
+                                                 myBodies[k].distance + myBodies[k].reach));
+            }
+        }
+        myDescendants.assign(count, vector<int>());
+        for (int k = 0; k < count; k++)
+        {
+            for (int c = myBodies[k].center; c >= 0; c = myBodies[c].center)
+            {
+                myDescendants[c].push_back(k);
+            }
+        }
+        myOffsetStarts.assign(count + 1, 0);
+        for (int k = 0; k < count; k++)
+        {
+            myOffsetStarts[k + 1] = myOffsetStarts[k] + 3 * myDescendants[k].size();
+        }
+        myGeneration = nextGeneration();
+    }
+
+
+    /*
+     * Turns drawing distant satellites as impostors on or off.
+     */
+    void toggleLOD ()
+    {
+        isLOD = ! isLOD;
+    }
+
+
+    /*
+     * Turns leaving out bodies hidden behind large spheres on or off;
+     * it is off at first, since wireframe spheres do not hide them.
+     */
+    void toggleOcclusion ()
+    {
+        isOcclusion = ! isOcclusion;
+    }
+
+
+    /*
+     * Decides what the next draw() on this thread leaves out, for the
+     * current modelview, projection and viewport.  draw() does this
+     * itself if it has not been done, but calling it first lets it be
+     * timed separately.
+     */
+    void cull (SolarSystem& system, const Point3& origin = Point3())
+    {
+        if (system.getBodyCount() == int(myBodies.size()))
+        {
+            View& view = getView();
+            setOrigin(view, origin);
+            cull(system, view);
+        }
+    }
+
+
+    /*
+     * Draws the bodies (and orbits, if shown) of the catalog last given
+     * to setBodies(), at its current angles (see SolarSystem::getWorld()),
+     * with the world position origin at the modelview's origin.
+     * Several threads may draw at once, each into its own context.
+     */
+    void draw (SolarSystem& system, const Point3& origin = Point3())
+    {
+        TRACE_SCOPE("BatchRenderer::draw");
+        if (system.getBodyCount() != int(myBodies.size()))
+        {
+            return;
+        }
+        Batch& batch = getBatch();
+        batch.drawCalls = 0;
+        View& view = getView();
+        if (view.isCulled && ! isOrigin(view, origin))
+        {
+            view.isCulled = false;
+        }
+        setOrigin(view, origin);
+        if (! view.isCulled)
+        {
+            cull(system, view);
+        }
+        view.isCulled = false;
+        DrawStats stats;
+        stats.occluded = view.numOccluded;
+        glEnableClientState(GL_VERTEX_ARRAY);
+        stats.stateChanges++;
+        if (system.isOrbitShown())
+        {
+            drawOrbits(system, view, batch, stats);
+        }
+        drawGroup<KIND_SUN>(system, view, batch, stats);
+        drawGroup<KIND_PLANET>(system, view, batch, stats);
+        drawGroup<KIND_MOON>(system, view, batch, stats);
+        drawImpostors(system, view, stats);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        stats.stateChanges++;
+        stats.drawCalls += batch.drawCalls;
+        count(stats);
+    }
+
+
+    /*
+     * Adds work issued elsewhere, e.g., by SolarSystem::draw(), to the
+     * totals returned by takeStats().
+     */
+    void count (const DrawStats& stats)
+    {
+        myNumDrawCalls += stats.drawCalls;
+        myNumStateChanges += stats.stateChanges;
+        myNumImpostors += stats.impostors;
+        myNumOccluded += stats.occluded;
+    }
+
+
+    /*
+     * Adds what batching keeps per body, its meshes, and the calling
+     * thread's view and batch (every drawing thread has its own) to
+     * the report as render buffers.
+     */
+    void reportMemory (MemoryReport& report)
+    {
+        size_t bytes = MemoryReport::bytesOf(myBodies) + MemoryReport::bytesOf(myDescendants) +
+                       MemoryReport::bytesOf(myOffsetStarts);
+        for (size_t k = 0; k < myDescendants.size(); k++)
+        {
+            bytes += MemoryReport::bytesOf(myDescendants[k]);
+        }
+        long objects = long(myBodies.size());
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            bytes += MemoryReport::bytesOf(myGroups[kind]) + mySpheres[kind].getBytes();
+        }
+        bytes += myOrbit.getBytes();
+        const View& view = getThreadView();
+        if (view.generation == myGeneration)
+        {
+            bytes += MemoryReport::bytesOf(view.isHidden) + MemoryReport::bytesOf(view.occluders) +
+                     MemoryReport::bytesOf(view.impostors) + MemoryReport::bytesOf(view.offsets) +
+                     MemoryReport::bytesOf(view.collapsed) + MemoryReport::bytesOf(view.points) +
+                     MemoryReport::bytesOf(view.colors) + MemoryReport::bytesOf(view.eyeX) +
+                     MemoryReport::bytesOf(view.eyeY) + MemoryReport::bytesOf(view.eyeZ);
+            objects++;
+        }
+        const Batch& batch = getBatch();
+        bytes += MemoryReport::bytesOf(batch.vertices) + MemoryReport::bytesOf(batch.bodies) +
+                 MemoryReport::bytesOf(batch.angles) + MemoryReport::bytesOf(batch.sines) +
+                 MemoryReport::bytesOf(batch.cosines);
+        report.add("render buffers", bytes, objects + 1);
+    }
+
+
+    /*
+     * Returns the work issued since the last call, and starts over.
+     */
+    DrawStats takeStats ()
+    {
+        DrawStats stats;
+        stats.drawCalls = myNumDrawCalls.exchange(0);
+        stats.stateChanges = myNumStateChanges.exchange(0);
+        stats.impostors = myNumImpostors.exchange(0);
+        stats.occluded = myNumOccluded.exchange(0);
+        return stats;
+    }
+
+
+    /*
+     * Returns the work SolarSystem::draw() issues for the catalog last
+     * given to setBodies(): a draw call per sphere and orbit, each with
+     * three vertex array changes, and a color change per body for it
+     * and every orbit center above it, each time it is transformed.
+     */
+    DrawStats countImmediate (bool showOrbits) const
+    {
+        DrawStats stats;
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            const vector<int>& group = myGroups[kind];
+            for (size_t k = 0; k < group.size(); k++)
+            {
+                int b = group[k];
+                stats.drawCalls++;
+                stats.stateChanges += myBodies[b].depth + 1 + 3;
+                if (showOrbits && hasOrbit(BodyKind(kind)) && myBodies[b].center >= 0)
+                {
+                    stats.drawCalls++;
+                    stats.stateChanges += myBodies[b].depth + 1 + 3;
+                }
+            }
+        }
+        return stats;
+    }
+};
+
+#endif
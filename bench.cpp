@@ -0,0 +1,1009 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This is the main file of the benchmark suite.  It measures
+// catalog parsing, name lookup, animation, restarts, world
+// positions, the state feed, transforms, vector math, sine and
+// cosine, updating bodies at multiple rates, headless rendering, CPU
+// splatting and allocations per frame, and writes the results as
+// JSON.  With --runs, the whole suite is run that many times and each
+// benchmark's samples from every run are written together.
+//
+// Usage: solarbench [--quick] [--filter text] [--reps n]
+//                   [--warmup n] [--runs n] [--json file]
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#include <cstdio>
+#include <cstring>           // for strcmp
+#include <cstdlib>           // for atoi
+#include <sstream>
+#include <iostream>
+#include "cglx.h"            // for CGLX or GLUT
+using namespace std;
+#include "scene.h"
+#include "benchmark.h"
+#include "catalog_generator.h"
+#include "offscreen.h"
+#include "state_feed.h"
+#include "splat_renderer.h"
+#include "trail_renderer.h"
+#include "sincos.h"
+#include "task_scheduler.h"
+#include "frame_profiler.h"
+#include "alloc_counter.h"
+
+
+//////////////////////////////////////////////////////////////////
+// Globals
+//
+// Variables
+//
+BenchmarkRunner theRunner;
+bool            isQuick = false;
+// keeps results alive so the compiler cannot discard the work
+volatile double theSink = 0;
+
+// Constants
+//
+const int          RENDER_WIDTH = 960;      // headless frame size
+const int          RENDER_HEIGHT = 540;
+const float        NEAR_DISTANCE = 0.1;     // same frustum as main.cpp
+const float        FAR_DISTANCE = 500;
+const float        FOV_ANGLE = 45;
+const int          NUM_LOOKUPS = 10000;     // names looked up per repetition
+const int          NUM_VECTORS = 1000000;   // tuples per vector math repetition
+const double       SPLAT_DISTANCE = 95000;  // eye distance that frames a 1M catalog
+const double       OVERVIEW_DISTANCE = 5800; // eye distance that frames a 10k catalog
+const int          NUM_WARMUP_FRAMES = 20;  // frames before allocations are counted
+const int          NUM_ALLOCATION_FRAMES = 50; // frames allocations are counted over
+const int          NUM_SCHEDULED_ITEMS = 1000000; // items per scheduler loop repetition
+const int          NUM_GROUP_TASKS = 64;    // tasks per task group repetition
+
+
+//////////////////////////////////////////////////////////////////
+//  Utility functions
+//
+/*
+ * Returns a synthetic catalog of the given size as text.
+ */
+string makeCatalog (int numBodies)
+{
+    ostringstream out;
+    CatalogGenerator().write(out, numBodies);
+    return out.str();
+}
+
+
+/*
+ * Returns a name for a label like "1k" from a count.
+ */
+string sizeLabel (int count)
+{
+    char label[32];
+    if (count >= 1000000)
+    {
+        snprintf(label, sizeof(label), "%dM", count / 1000000);
+    }
+    else if (count >= 1000)
+    {
+        snprintf(label, sizeof(label), "%dk", count / 1000);
+    }
+    else
+    {
+        snprintf(label, sizeof(label), "%d", count);
+    }
+    return label;
+}
+
+
+//////////////////////////////////////////////////////////////////
+//  Benchmarks
+//
+/*
+ * A fixed workload that never changes, so the regression gate can
+ * tell a slower machine from slower code.
+ */
+void benchCalibration ()
+{
+    theRunner.run("calibration/reference", 1000000, [&] {
+        double x = 1;
+        for (int k = 0; k < 1000000; k++)
+        {
+            x = x * 1.0000001 + 1e-9;
+        }
+        theSink = theSink + x;
+    });
+}
+
+
+/*
+ * Parsing the shipped catalog and synthetic ones.
+ */
+void benchLoad ()
+{
+    SolarSystem * system = NULL;
+    theRunner.runWithReset("load/default", 10,
+        [&] { system = new SolarSystem(); },
+        [&] { theSink = theSink + system->getBodyCount(); delete system; },
+        isQuick ? 5 : 20);
+
+    const int SIZES[] = { 1000, 100000 };
+    for (int k = 0; k < 2; k++)
+    {
+        string name = "load/" + sizeLabel(SIZES[k]);
+        if (! theRunner.isSelected(name) || (isQuick && SIZES[k] > 1000))
+        {
+            continue;
+        }
+        string catalog = makeCatalog(SIZES[k]);
+        theRunner.runWithReset(name, SIZES[k],
+            [&] { istringstream in(catalog); system = new SolarSystem(in); },
+            [&] { theSink = theSink + system->getBodyCount(); delete system; },
+            SIZES[k] > 1000 ? 5 : 10);
+    }
+}
+
+
+/*
+ * Looking up bodies by name, as the loader does for every parent.
+ */
+void benchLookup ()
+{
+    const int SIZES[] = { 1000, 100000 };
+    for (int k = 0; k < 2; k++)
+    {
+        string name = "lookup/" + sizeLabel(SIZES[k]);
+        if (! theRunner.isSelected(name) || (isQuick && SIZES[k] > 1000))
+        {
+            continue;
+        }
+        istringstream in(makeCatalog(SIZES[k]));
+        SolarSystem system(in);
+        vector<string> names;
+        for (int n = 0; n < NUM_LOOKUPS; n++)
+        {
+            names.push_back(system.getBody((n * 7919) % system.getBodyCount())->getName());
+        }
+        theRunner.run(name, NUM_LOOKUPS, [&] {
+            for (int n = 0; n < NUM_LOOKUPS; n++)
+            {
+                theSink = theSink + (system.get(names[n]) != NULL);
+            }
+        });
+    }
+}
+
+
+/*
+ * Advancing the simulation by one tick.
+ */
+void benchAnimate ()
+{
+    const int SIZES[] = { 1000, 100000, 1000000 };
+    for (int k = 0; k < 3; k++)
+    {
+        string name = "animate/" + sizeLabel(SIZES[k]);
+        if (! theRunner.isSelected(name) || (isQuick && SIZES[k] > 100000))
+        {
+            continue;
+        }
+        SolarSystem * system;
+        {
+            istringstream in(makeCatalog(SIZES[k]));
+            system = new SolarSystem(in);
+        }
+        theRunner.run(name, SIZES[k], [&] { system->animate(); });
+        theSink = theSink + system->getBody(0)->getRotationAngle();
+        delete system;
+    }
+}
+
+/*
+ * Starting the simulation over, which should cost about as little as
+ * one tick rather than a reload.
+ */
+void benchRestart ()
+{
+    const int SIZES[] = { 1000, 1000000 };
+    for (int k = 0; k < 2; k++)
+    {
+        string name = "restart/" + sizeLabel(SIZES[k]);
+        if (! theRunner.isSelected(name) || (isQuick && SIZES[k] > 100000))
+        {
+            continue;
+        }
+        istringstream in(makeCatalog(SIZES[k]));
+        SolarSystem system(in);
+        system.animate();
+        theRunner.run(name, SIZES[k], [&] { system.restart(); });
+        theSink = theSink + system.getBody(0)->getRotationAngle();
+    }
+}
+
+
+/*
+ * A tick followed by finding every body's world position, against a
+ * tick followed by asking for only one body in a hundred (e.g., those
+ * picked or exported), which should cost little more than the tick.
+ */
+void benchLazy ()
+{
+    const int SIZES[] = { 100000, 1000000 };
+    for (int k = 0; k < 2; k++)
+    {
+        string label = sizeLabel(SIZES[k]);
+        if ((! theRunner.isSelected("lazy/tick_and_update/" + label) &&
+             ! theRunner.isSelected("lazy/tick_and_pick/" + label)) ||
+            (isQuick && SIZES[k] > 100000))
+        {
+            continue;
+        }
+        istringstream in(makeCatalog(SIZES[k]));
+        SolarSystem system(in);
+        theRunner.run("lazy/tick_and_update/" + label, SIZES[k], [&] {
+            system.animate();
+            theSink = theSink + system.getState().x[SIZES[k] - 1];
+        });
+        theRunner.run("lazy/tick_and_pick/" + label, SIZES[k], [&] {
+            system.animate();
+            for (int b = 0; b < SIZES[k]; b += 100)
+            {
+                theSink = theSink + system.getWorld(int(long(b) * 7919 % SIZES[k])).getX();
+            }
+        });
+    }
+}
+
+
+/*
+ * A tick, and a tick followed by finding every body's world position,
+ * with each body updated only as often as keeps it within a pixel of
+ * where it would be, seen from where a 1M catalog is framed (against
+ * animate/ and lazy/, which update every body); the share of bodies
+ * updated per tick; and the worst error seen over a few reschedules,
+ * as a share of the error allowed, which must stay at most 1.
+ */
+void benchMultiRate ()
+{
+    // a pixel of a 1080-line view at unit distance
+    const double PIXEL = 2 * tan(FOV_ANGLE / 2 * M_PI / 180) / 1080;
+    if ((theRunner.isSelected("multirate/animate/1M") ||
+         theRunner.isSelected("multirate/tick_and_update/1M")) && ! isQuick)
+    {
+        istringstream in(makeCatalog(1000000));
+        SolarSystem system(in);
+        system.setEye(Point3(0, 0.6 * SPLAT_DISTANCE, 0.8 * SPLAT_DISTANCE));
+        system.setMultiRate(0, PIXEL);
+        theRunner.run("multirate/animate/1M", 1000000, [&] { system.animate(); });
+        theRunner.run("multirate/tick_and_update/1M", 1000000, [&] {
+            system.animate();
+            theSink = theSink + system.getState().x[1000000 - 1];
+        });
+        theRunner.record("multirate/update_fraction/1M", system.getUpdateFraction());
+    }
+    if (theRunner.isSelected("multirate/error_ratio/100k"))
+    {
+        const int NUM_BODIES = 100000, NUM_TICKS = 200;
+        string catalog = makeCatalog(NUM_BODIES);
+        istringstream exactIn(catalog), multiIn(catalog);
+        SolarSystem exact(exactIn), multi(multiIn);
+        Point3 eye(0, 0.6 * OVERVIEW_DISTANCE, 0.8 * OVERVIEW_DISTANCE);
+        multi.setEye(eye);
+        multi.setMultiRate(0, PIXEL);
+        double worst = 0;
+        for (int tick = 0; tick < NUM_TICKS; tick++)
+        {
+            exact.animate();
+            multi.animate();
+            const BodyState& want = exact.getState();
+            const BodyState& got = multi.getState();
+            for (int b = 0; b < NUM_BODIES; b++)
+            {
+                Point3 position(want.x[b], want.y[b], want.z[b]);
+                double error = position.distance(Point3(got.x[b], got.y[b], got.z[b]));
+                if (error > 0)
+                {
+                    worst = max(worst, error / (PIXEL * eye.distance(position)));
+                }
+            }
+        }
+        theRunner.record("multirate/error_ratio/100k", worst);
+    }
+}
+
+
+/*
+ * Finding world positions on the CPU, publishing them to the shared
+ * memory feed (which should cost no more than copying them) and
+ * adding them to trails (which should not depend on trail length).
+ */
+void benchState ()
+{
+    const int SIZES[] = { 1000, 100000 };
+    for (int k = 0; k < 2; k++)
+    {
+        string label = sizeLabel(SIZES[k]);
+        if ((! theRunner.isSelected("state/update/" + label) &&
+             ! theRunner.isSelected("feed/publish/" + label) &&
+             ! theRunner.isSelected("trail/append/" + label)) ||
+            (isQuick && SIZES[k] > 1000))
+        {
+            continue;
+        }
+        istringstream in(makeCatalog(SIZES[k]));
+        SolarSystem system(in);
+        system.animate();
+        theRunner.run("state/update/" + label, SIZES[k], [&] { system.updateState(); });
+        system.updateState();
+
+        TrailRenderer trails;
+        trails.setBodies(&system);
+        trails.toggle();
+        theRunner.run("trail/append/" + label, SIZES[k], [&] { trails.append(system.getState()); });
+
+        StateFeed feed;
+        if (! feed.create("/solarbench", SIZES[k]))
+        {
+            cerr << "No shared memory, skipping feed benchmarks" << endl;
+            continue;
+        }
+        theRunner.run("feed/publish/" + label, SIZES[k], [&] { feed.publish(system.getState()); });
+    }
+}
+
+
+/*
+ * Basic operations of vector_math.h over large arrays.
+ */
+void benchVectorMath ()
+{
+    if (! theRunner.isSelected("vector_math/"))
+    {
+        return;
+    }
+    vector<Vector3> a(NUM_VECTORS), b(NUM_VECTORS), c(NUM_VECTORS);
+    vector<Point3> p(NUM_VECTORS);
+    for (int k = 0; k < NUM_VECTORS; k++)
+    {
+        a[k].set(k % 17 + 1, k % 13 - 6, k % 7 + 0.5);
+        b[k].set(k % 5 - 2, k % 11 + 1, k % 3 - 1.5);
+        p[k].set(k % 19, k % 23, k % 29);
+    }
+    theRunner.run("vector_math/cross", NUM_VECTORS, [&] {
+        for (int k = 0; k < NUM_VECTORS; k++)
+        {
+            c[k].cross(a[k], b[k]);
+        }
+        theSink = theSink + c[NUM_VECTORS / 2].x;
+    });
+    theRunner.run("vector_math/dot", NUM_VECTORS, [&] {
+        double sum = 0;
+        for (int k = 0; k < NUM_VECTORS; k++)
+        {
+            sum += a[k].dot(b[k]);
+        }
+        theSink = theSink + sum;
+    });
+    theRunner.run("vector_math/normalize", NUM_VECTORS, [&] {
+        for (int k = 0; k < NUM_VECTORS; k++)
+        {
+            c[k].set(a[k]);
+            c[k].normalize();
+        }
+        theSink = theSink + c[NUM_VECTORS / 2].y;
+    });
+    theRunner.run("vector_math/scale_add", NUM_VECTORS, [&] {
+        for (int k = 0; k < NUM_VECTORS; k++)
+        {
+            c[k].scaleAdd(0.5, b[k]);
+        }
+        theSink = theSink + c[NUM_VECTORS / 2].z;
+    });
+    theRunner.run("vector_math/distance", NUM_VECTORS, [&] {
+        double sum = 0;
+        for (int k = 1; k < NUM_VECTORS; k++)
+        {
+            sum += p[k].distance(p[k - 1]);
+        }
+        theSink = theSink + sum;
+    });
+
+    // points as BodyState keeps them, and one matrix per body
+    vector<double> xs(NUM_VECTORS), ys(NUM_VECTORS), zs(NUM_VECTORS);
+    vector<double> outX(NUM_VECTORS), outY(NUM_VECTORS), outZ(NUM_VECTORS);
+    for (int k = 0; k < NUM_VECTORS; k++)
+    {
+        xs[k] = p[k].x;
+        ys[k] = p[k].y;
+        zs[k] = p[k].z;
+    }
+    Matrix4 view = Matrix4::translation(-65, -13, -3) * Matrix4::rotation(30, Vector3(0.2, 1, 0.1));
+    theRunner.run("vector_math/matrix/points", NUM_VECTORS, [&] {
+        view.transformPoints(&xs[0], &ys[0], &zs[0], NUM_VECTORS, &outX[0], &outY[0], &outZ[0]);
+        theSink = theSink + outX[NUM_VECTORS / 2];
+    });
+    const int NUM_MATRICES = NUM_VECTORS / 16;
+    vector<Matrix4> ma(NUM_MATRICES), mb(NUM_MATRICES), mc(NUM_MATRICES);
+    for (int k = 0; k < NUM_MATRICES; k++)
+    {
+        ma[k] = Matrix4::rotation(k % 360, a[k]) * Matrix4::translation(k % 7, 1, 2);
+        mb[k] = Matrix4::rotation(k % 90, b[k]);
+    }
+    theRunner.run("vector_math/matrix/compose", NUM_MATRICES, [&] {
+        Matrix4::multiply(&ma[0], &mb[0], &mc[0], NUM_MATRICES);
+        theSink = theSink + mc[NUM_MATRICES / 2].m[5];
+    });
+    theRunner.run("vector_math/matrix/axis_angle", NUM_MATRICES, [&] {
+        for (int k = 0; k < NUM_MATRICES; k++)
+        {
+            mc[k] = Matrix4::rotation(k % 360, a[k]);
+        }
+        theSink = theSink + mc[NUM_MATRICES / 2].m[0];
+    });
+}
+
+/*
+ * Sines and cosines of many angles in degrees, as world positions
+ * need them, and the largest error of each accuracy.  Angles run up
+ * to those of long soak runs, which should cost no more than small
+ * ones.
+ */
+void benchSinCos ()
+{
+    if (! theRunner.isSelected("sincos/"))
+    {
+        return;
+    }
+    vector<double> degrees(NUM_VECTORS), sines(NUM_VECTORS), cosines(NUM_VECTORS);
+    for (int k = 0; k < NUM_VECTORS; k++)
+    {
+        // a quarter up to 10^9 degrees, the rest within a few turns
+        degrees[k] = (k % 4 == 0) ? k * 1000.37 : (k % 2000) * 0.731 - 400;
+    }
+    const char * NAMES[] = { "libm", "precise", "fast" };
+    for (int a = 0; a < NUM_SINCOS_ACCURACIES; a++)
+    {
+        SinCosAccuracy accuracy = SinCosAccuracy(a);
+        theRunner.run(string("sincos/") + NAMES[a], NUM_VECTORS, [&] {
+            sinCosDegrees(&degrees[0], NUM_VECTORS, &sines[0], &cosines[0], accuracy);
+            theSink = theSink + sines[NUM_VECTORS / 2] + cosines[NUM_VECTORS / 3];
+        });
+
+        // against long double, reduced exactly
+        double maxError = 0;
+        sinCosDegrees(&degrees[0], NUM_VECTORS, &sines[0], &cosines[0], accuracy);
+        for (int k = 0; k < NUM_VECTORS; k++)
+        {
+            long double radians = fmodl(degrees[k], 360.0L) * (M_PIl / 180);
+            maxError = max(maxError, double(fabsl(sines[k] - sinl(radians))));
+            maxError = max(maxError, double(fabsl(cosines[k] - cosl(radians))));
+        }
+        theRunner.record(string("sincos/error/") + NAMES[a], maxError);
+    }
+}
+
+
+
+/*
+ * Sets up the default camera for a headless frame.
+ */
+void setHeadlessCamera ()
+{
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(FOV_ANGLE, GLdouble(RENDER_WIDTH) / RENDER_HEIGHT,
+                   NEAR_DISTANCE, FAR_DISTANCE);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gluLookAt(Scene::DEFAULT_CAMERA_FROM.x, Scene::DEFAULT_CAMERA_FROM.y, Scene::DEFAULT_CAMERA_FROM.z,
+              Scene::DEFAULT_CAMERA_TO.x, Scene::DEFAULT_CAMERA_TO.y, Scene::DEFAULT_CAMERA_TO.z,
+              Scene::DEFAULT_CAMERA_UP.x, Scene::DEFAULT_CAMERA_UP.y, Scene::DEFAULT_CAMERA_UP.z);
+}
+
+
+/*
+ * Fills the column-major matrices gluPerspective and gluLookAt would
+ * build for a view from far above the ecliptic, without needing a
+ * GL context.
+ */
+void makeOverviewMatrices (double modelview[16], double projection[16])
+{
+    const double aspect = double(RENDER_WIDTH) / RENDER_HEIGHT;
+    const double nearPlane = 1, farPlane = 2 * SPLAT_DISTANCE;
+    double f = 1 / tan(FOV_ANGLE * M_PI / 360);
+    fill(projection, projection + 16, 0.0);
+    projection[0] = f / aspect;
+    projection[5] = f;
+    projection[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+    projection[11] = -1;
+    projection[14] = 2 * farPlane * nearPlane / (nearPlane - farPlane);
+
+    // looking at the origin from (0, 0.6, 0.8) * SPLAT_DISTANCE, y up
+    const double forward[3] = { 0, -0.6, -0.8 };
+    const double side[3] = { 1, 0, 0 };
+    const double up[3] = { 0, 0.8, -0.6 };
+    fill(modelview, modelview + 16, 0.0);
+    for (int k = 0; k < 3; k++)
+    {
+        modelview[k * 4] = side[k];
+        modelview[k * 4 + 1] = up[k];
+        modelview[k * 4 + 2] = -forward[k];
+    }
+    modelview[14] = -SPLAT_DISTANCE;
+    modelview[15] = 1;
+}
+
+
+/*
+ * Whole frames of the CPU splat renderer over large catalogs.
+ */
+void benchSplat ()
+{
+    const int SIZES[] = { 100000, 1000000 };
+    double modelview[16], projection[16];
+    makeOverviewMatrices(modelview, projection);
+    SplatRenderer renderer;
+    for (int k = 0; k < 2; k++)
+    {
+        string name = "splat/" + sizeLabel(SIZES[k]);
+        if (! theRunner.isSelected(name) || (isQuick && SIZES[k] > 100000))
+        {
+            continue;
+        }
+        istringstream in(makeCatalog(SIZES[k]));
+        SolarSystem system(in);
+        system.animate();
+        system.updateState();
+        renderer.setBodies(&system);
+        theRunner.run(name, SIZES[k], [&] {
+            renderer.render(system.getState(), modelview, projection, RENDER_WIDTH, RENDER_HEIGHT);
+        });
+    }
+}
+
+
+/*
+ * Sets up a camera far enough out to see a whole 10k catalog, where
+ * most moon systems are only a few pixels across.
+ */
+void setOverviewCamera ()
+{
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(FOV_ANGLE, GLdouble(RENDER_WIDTH) / RENDER_HEIGHT,
+                   1, 2 * OVERVIEW_DISTANCE);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gluLookAt(0, 0.6 * OVERVIEW_DISTANCE, 0.8 * OVERVIEW_DISTANCE, 0, 0, 0, 0, 1, 0);
+}
+
+
+/*
+ * Sets up the headless frustum looking at a body from just beside it,
+ * from where most of a large catalog is out of view.
+ */
+void setCloseCamera (const Affine& body)
+{
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(FOV_ANGLE, GLdouble(RENDER_WIDTH) / RENDER_HEIGHT,
+                   NEAR_DISTANCE, FAR_DISTANCE);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gluLookAt(body.getX() + 2, body.getY() + 1, body.getZ() + 2,
+              body.getX(), body.getY(), body.getZ(), 0, 1, 0);
+}
+
+
+/*
+ * Per-body transforms and whole frames, rendered offscreen, both one
+ * body at a time and batched by kind, plus batched overview frames
+ * where distant moons are drawn as impostors, and the culling pass on
+ * its own, also following a planet through a tick at a time.
+ */
+void benchRender ()
+{
+    if (! theRunner.isSelected("transform/") && ! theRunner.isSelected("render/") &&
+        ! theRunner.isSelected("batch/") && ! theRunner.isSelected("lod/") &&
+        ! theRunner.isSelected("cull/"))
+    {
+        return;
+    }
+    OffscreenContext context;
+    if (! context.create(RENDER_WIDTH, RENDER_HEIGHT))
+    {
+        cerr << "No offscreen context, skipping transform and render benchmarks" << endl;
+        return;
+    }
+    glClearColor(0, 0, 0, 0);
+    glEnable(GL_DEPTH_TEST);
+
+    const int SIZES[] = { 0, 1000, 10000 };
+    for (int k = 0; k < 3; k++)
+    {
+        if (isQuick && SIZES[k] > 1000)
+        {
+            continue;
+        }
+        SolarSystem * system;
+        if (SIZES[k] == 0)
+        {
+            system = new SolarSystem();
+        }
+        else
+        {
+            istringstream in(makeCatalog(SIZES[k]));
+            system = new SolarSystem(in);
+        }
+        string label = (SIZES[k] == 0) ? "default" : sizeLabel(SIZES[k]);
+        int numBodies = system->getBodyCount();
+        setHeadlessCamera();
+
+        theRunner.run("transform/" + label, numBodies, [&] {
+            for (int b = 0; b < numBodies; b++)
+            {
+                glPushMatrix();
+                system->getBody(b)->transform();
+                glPopMatrix();
+            }
+            glFinish();
+        });
+        theRunner.run("render/" + label, numBodies, [&] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glPushMatrix();
+            system->draw();
+            glPopMatrix();
+            glFinish();
+        });
+        BatchRenderer batches;
+        system->updateState();
+        batches.setBodies(system);
+        theRunner.run("cull/" + label, numBodies, [&] { batches.cull(*system); });
+        theRunner.run("batch/" + label, numBodies, [&] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glPushMatrix();
+            batches.draw(*system);
+            glPopMatrix();
+            glFinish();
+        });
+        if (SIZES[k] > 0)
+        {
+            setOverviewCamera();
+            theRunner.run("lod/" + label, numBodies, [&] {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glPushMatrix();
+                batches.draw(*system);
+                glPopMatrix();
+                glFinish();
+            });
+            theRunner.run("cull/close/" + label, numBodies, [&] {
+                system->animate();
+                setCloseCamera(system->getWorld(1));
+                batches.cull(*system);
+            });
+        }
+        delete system;
+    }
+}
+
+/*
+ * Heap allocations per steady-state frame on each path, all of which
+ * should be none: allocations show up as tail latency on the wall.
+ * Every path is warmed up first, so buffers and the driver's caches
+ * have settled, then counted over NUM_ALLOCATION_FRAMES frames.  The
+ * frame profiler is run for longer than it keeps history, and has its
+ * percentiles refreshed, as a long session would.
+ */
+void benchAllocations ()
+{
+    if (! theRunner.isSelected("alloc/"))
+    {
+        return;
+    }
+    OffscreenContext context;
+    if (! context.create(RENDER_WIDTH, RENDER_HEIGHT))
+    {
+        cerr << "No offscreen context, skipping allocation counts" << endl;
+        return;
+    }
+    glClearColor(0, 0, 0, 0);
+    glEnable(GL_DEPTH_TEST);
+
+    // two threads in all, so the paths run in parallel are counted too
+    TaskScheduler scheduler;
+    char * ARGUMENTS[] = { (char *)"solarbench", (char *)"-threads", (char *)"2" };
+    Scene scene;
+    scene.setScheduler(&scheduler);
+    scene.init(GLfloat(RENDER_WIDTH) / RENDER_HEIGHT, 3, ARGUMENTS);
+    {
+        istringstream in(makeCatalog(1000));
+        scene.load(in);
+    }
+    SolarSystem * system = scene.getSolarSystem();
+    // far enough out that distant moons become impostors
+    const double OVERVIEW[9] = { 0, 0.6 * OVERVIEW_DISTANCE, 0.8 * OVERVIEW_DISTANCE, 0, 0, 0, 0, 1, 0 };
+    scene.setCameraState(OVERVIEW);
+    scene.getTrails().toggle();
+    StateFeed feed;
+    bool isFeeding = feed.create("/solarbench", system->getBodyCount());
+    SplatRenderer splats;
+    splats.setBodies(system);
+    double modelview[16], projection[16];
+    makeOverviewMatrices(modelview, projection);
+
+    // allocations counted on this thread by each part of a frame
+    enum { SIMULATE, FEED, CULL, DRAW, IMMEDIATE, SPLAT, NUM_PATHS };
+    const char * NAMES[NUM_PATHS] = { "simulate", "feed", "cull", "draw", "immediate", "splat" };
+    long counts[NUM_PATHS] = { 0 };
+    for (int frame = 0; frame < NUM_WARMUP_FRAMES + NUM_ALLOCATION_FRAMES; frame++)
+    {
+        if (frame == NUM_WARMUP_FRAMES)
+        {
+            fill(counts, counts + NUM_PATHS, 0);
+        }
+        long start = countAllocations();
+        scene.update();
+        counts[SIMULATE] += countAllocations() - start;
+
+        start = countAllocations();
+        if (isFeeding)
+        {
+            feed.publish(system->getState());
+        }
+        counts[FEED] += countAllocations() - start;
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        gluPerspective(FOV_ANGLE, GLdouble(RENDER_WIDTH) / RENDER_HEIGHT, 1, 2 * OVERVIEW_DISTANCE);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        scene.setCamera();
+        start = countAllocations();
+        scene.cull();
+        counts[CULL] += countAllocations() - start;
+
+        start = countAllocations();
+        scene.display();
+        glFinish();
+        counts[DRAW] += countAllocations() - start;
+
+        // the same frame drawn one body at a time
+        scene.keyPressed('b', 0, 0, 0);
+        start = countAllocations();
+        scene.display();
+        glFinish();
+        counts[IMMEDIATE] += countAllocations() - start;
+        scene.keyPressed('b', 0, 0, 0);
+
+        start = countAllocations();
+        splats.render(system->getState(), modelview, projection, RENDER_WIDTH, RENDER_HEIGHT);
+        counts[SPLAT] += countAllocations() - start;
+    }
+    for (int k = 0; k < NUM_PATHS; k++)
+    {
+        theRunner.record(string("alloc/") + NAMES[k], double(counts[k]) / NUM_ALLOCATION_FRAMES);
+    }
+
+    // profiling frames for longer than the profiler keeps history,
+    // refreshing the percentiles every second at 60 fps, as the title does
+    FrameProfiler profiler;
+    const int NUM_PROFILED_FRAMES = 2 * FrameProfiler::HISTORY_SIZE;
+    const int FRAMES_PER_SUMMARY = 60;
+    long start = countAllocations();
+    for (int frame = 0; frame < NUM_PROFILED_FRAMES; frame++)
+    {
+        profiler.begin(PHASE_SIMULATE);
+        profiler.end(PHASE_SIMULATE);
+        profiler.endFrame();
+        if (frame % FRAMES_PER_SUMMARY == 0)
+        {
+            profiler.updateSummary();
+        }
+    }
+    theRunner.record("alloc/profiler", double(countAllocations() - start) / NUM_PROFILED_FRAMES);
+}
+
+
+/*
+ * The scheduler's own cost: a parallel loop over items that do almost
+ * nothing, split at several grain sizes, and a group of empty tasks.
+ * Then loading, a tick and an update of large catalogs on its threads,
+ * to compare with load/, animate/ and state/update/.
+ */
+void benchScheduler ()
+{
+    if (! theRunner.isSelected("sched/"))
+    {
+        return;
+    }
+    TaskScheduler scheduler;
+    // at least one worker, so tasks are queued and stolen even on one core
+    scheduler.start(max(2, int(thread::hardware_concurrency())));
+
+    vector<double> values(NUM_SCHEDULED_ITEMS, 0);
+    const int GRAINS[] = { 256, 4096, 65536 };
+    for (int g = 0; g < 3; g++)
+    {
+        int grain = GRAINS[g];
+        theRunner.run("sched/parallel_for/" + to_string(grain), NUM_SCHEDULED_ITEMS, [&] {
+            scheduler.parallelFor(0, NUM_SCHEDULED_ITEMS, grain, [&](int begin, int end) {
+                for (int k = begin; k < end; k++)
+                {
+                    values[k] += 1;
+                }
+            });
+        });
+    }
+    theSink = theSink + values[0];
+    atomic<int> numRun(0);
+    auto task = [&] { numRun++; };
+    theRunner.run("sched/group/" + to_string(NUM_GROUP_TASKS), NUM_GROUP_TASKS, [&] {
+        TaskGroup group(scheduler);
+        for (int k = 0; k < NUM_GROUP_TASKS; k++)
+        {
+            group.run(task);
+        }
+        group.wait();
+    });
+    theSink = theSink + numRun;
+
+    if (theRunner.isSelected("sched/load/100k") && ! isQuick)
+    {
+        string catalog = makeCatalog(100000);
+        SolarSystem * system = NULL;
+        theRunner.runWithReset("sched/load/100k", 100000,
+            [&] { istringstream in(catalog); system = new SolarSystem(in, &scheduler); },
+            [&] { theSink = theSink + system->getBodyCount(); delete system; },
+            5);
+    }
+    const int SIZES[] = { 100000, 1000000 };
+    for (int k = 0; k < 2; k++)
+    {
+        string label = sizeLabel(SIZES[k]);
+        if ((! theRunner.isSelected("sched/animate/" + label) &&
+             ! theRunner.isSelected("sched/state/update/" + label)) ||
+            (isQuick && SIZES[k] > 100000))
+        {
+            continue;
+        }
+        istringstream in(makeCatalog(SIZES[k]));
+        SolarSystem system(in, &scheduler);
+        theRunner.run("sched/animate/" + label, SIZES[k], [&] { system.animate(); });
+        theRunner.run("sched/state/update/" + label, SIZES[k], [&] { system.updateState(); });
+        theSink = theSink + system.getState().x[1];
+    }
+}
+
+
+/*
+ * Memory held per body by each subsystem once a catalog is loaded and
+ * has been drawn with trails on, and in all (memory/bytes_per_body),
+ * which render nodes are sized from.
+ */
+void benchMemory ()
+{
+    if (! theRunner.isSelected("memory/"))
+    {
+        return;
+    }
+    OffscreenContext context;
+    if (! context.create(RENDER_WIDTH, RENDER_HEIGHT))
+    {
+        cerr << "No offscreen context, skipping memory" << endl;
+        return;
+    }
+    const int SIZES[] = { 1000, 100000 };
+    for (int k = 0; k < 2; k++)
+    {
+        if (isQuick && SIZES[k] > 1000)
+        {
+            continue;
+        }
+        string label = sizeLabel(SIZES[k]);
+        Scene scene;
+        scene.init(GLfloat(RENDER_WIDTH) / RENDER_HEIGHT, 0, NULL);
+        {
+            istringstream in(makeCatalog(SIZES[k]));
+            scene.load(in);
+        }
+        scene.getTrails().toggle();
+        for (int frame = 0; frame < 2; frame++)
+        {
+            scene.update();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glLoadIdentity();
+            scene.setCamera();
+            scene.cull();
+            scene.display();
+        }
+        glFinish();
+
+        MemoryReport report;
+        scene.reportMemory(report);
+        const vector<MemoryUsage>& usages = report.getUsages();
+        for (size_t u = 0; u < usages.size(); u++)
+        {
+            string subsystem = usages[u].subsystem;
+            replace(subsystem.begin(), subsystem.end(), ' ', '_');
+            theRunner.record("memory/" + subsystem + "/" + label,
+                             double(usages[u].bytes) / report.getBodyCount());
+        }
+        theRunner.record("memory/bytes_per_body/" + label, report.getBytesPerBody());
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////
+// Main Function
+//
+int main (int argc, char *argv[])
+{
+    const char * jsonFile = "bench_results.json";
+    int warmups = 2, repetitions = 10, runs = 1;
+    for (int k = 1; k < argc; k++)
+    {
+        if (strcmp(argv[k], "--quick") == 0)
+        {
+            isQuick = true;
+            repetitions = 5;
+        }
+        else if (strcmp(argv[k], "--filter") == 0 && k + 1 < argc)
+        {
+            theRunner.setFilter(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--reps") == 0 && k + 1 < argc)
+        {
+            repetitions = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--warmup") == 0 && k + 1 < argc)
+        {
+            warmups = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--runs") == 0 && k + 1 < argc)
+        {
+            runs = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "--json") == 0 && k + 1 < argc)
+        {
+            jsonFile = argv[++k];
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--quick] [--filter text] [--reps n]"
+                 << " [--warmup n] [--runs n] [--json file]" << endl;
+            return 2;
+        }
+    }
+    theRunner.setRepetitions(warmups, repetitions < 1 ? 1 : repetitions);
+
+    BenchmarkRunner::printHeader();
+    for (int run = 0; run < runs; run++)
+    {
+        benchCalibration();
+        benchLoad();
+        benchLookup();
+        benchAnimate();
+        benchRestart();
+        benchLazy();
+        benchMultiRate();
+        benchState();
+        benchVectorMath();
+        benchSinCos();
+        benchScheduler();
+        benchSplat();
+        benchRender();
+        benchAllocations();
+        benchMemory();
+    }
+
+    if (! theRunner.writeJSON(jsonFile))
+    {
+        cerr << "Could not write " << jsonFile << endl;
+        return 1;
+    }
+    cout << "Wrote " << theRunner.getResults().size() << " results to " << jsonFile << endl;
+    return 0;
+}
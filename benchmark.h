@@ -0,0 +1,550 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a small benchmark harness: each benchmark is
+// warmed up, then timed for a number of repetitions, and the
+// samples are summarized (min, median, mean, standard deviation,
+// p95, max) and written as a table or as JSON.
+//
+// Benchmarks faster than MIN_REPETITION_MS are run several times
+// per repetition and the sample is the average, so timer
+// resolution and scheduling jitter do not dominate them.
+//
+// A benchmark run again under the same name (e.g., the whole suite
+// run several times, to record a baseline) adds its samples to the
+// ones it already has, so a slow stretch of the machine is one of
+// several runs rather than all of them.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <time.h>            // clock_gettime
+#include <math.h>
+#include <cstdio>            // for fopen, snprintf
+#include <cstdlib>           // for strtod
+#include <string>
+#include <vector>
+#include <algorithm>         // for sort
+#include <iostream>
+
+using namespace std;
+
+/*
+ * Samples and summary of one benchmark.
+ */
+struct BenchmarkResult
+{
+    string name;
+    // work done per repetition (bodies, pixels, operations, ...)
+    double items;
+    // milliseconds per repetition
+    vector<double> samples;
+    double minimum, median, mean, stddev, p95, maximum;
+
+    void summarize ()
+    {
+        vector<double> sorted(samples);
+        sort(sorted.begin(), sorted.end());
+        size_t n = sorted.size();
+        minimum = sorted[0];
+        maximum = sorted[n - 1];
+        median = (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+        p95 = sorted[size_t(0.95 * (n - 1) + 0.5)];
+        mean = 0;
+        for (size_t k = 0; k < n; k++)
+        {
+            mean += sorted[k];
+        }
+        mean /= n;
+        stddev = 0;
+        for (size_t k = 0; k < n; k++)
+        {
+            stddev += (sorted[k] - mean) * (sorted[k] - mean);
+        }
+        stddev = (n > 1) ? sqrt(stddev / (n - 1)) : 0;
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+/*
+ * Reads the JSON written by BenchmarkRunner::writeJSON.
+ *
+ * Only the subset of JSON that file uses is understood: objects,
+ * arrays, strings without escapes and numbers.
+ */
+class BenchmarkReader
+{
+  private:
+    const char * myText;
+    size_t myPos;
+    bool myFailed;
+
+    void skipSpace ()
+    {
+        while (myText[myPos] == ' ' || myText[myPos] == '\n' ||
+               myText[myPos] == '\t' || myText[myPos] == '\r')
+        {
+            myPos++;
+        }
+    }
+
+    bool expect (char c)
+    {
+        skipSpace();
+        if (myText[myPos] != c)
+        {
+            myFailed = true;
+            return false;
+        }
+        myPos++;
+        return true;
+    }
+
+    bool peek (char c)
+    {
+        skipSpace();
+        return myText[myPos] == c;
+    }
+
+    string readString ()
+    {
+        string result;
+        if (expect('"'))
+        {
+            while (myText[myPos] != '"' && myText[myPos] != '\0')
+            {
+                result += myText[myPos++];
+            }
+            expect('"');
+        }
+        return result;
+    }
+
+    double readNumber ()
+    {
+        skipSpace();
+        char * end;
+        double value = strtod(myText + myPos, &end);
+        if (end == myText + myPos)
+        {
+            myFailed = true;
+        }
+        myPos = end - myText;
+        return value;
+    }
+
+    // reads and discards any value
+    void skipValue ()
+    {
+        if (peek('"'))
+        {
+            readString();
+        }
+        else if (peek('{') || peek('['))
+        {
+            char close = (myText[myPos] == '{') ? '}' : ']';
+            myPos++;
+            while (! myFailed && ! peek(close))
+            {
+                if (close == '}')
+                {
+                    readString();
+                    expect(':');
+                }
+                skipValue();
+                if (! peek(close))
+                {
+                    expect(',');
+                }
+            }
+            expect(close);
+        }
+        else
+        {
+            readNumber();
+        }
+    }
+
+    void readBenchmark (vector<BenchmarkResult>& results)
+    {
+        BenchmarkResult result;
+        result.items = 1;
+        expect('{');
+        while (! myFailed && ! peek('}'))
+        {
+            string key = readString();
+            expect(':');
+            if (key == "name")
+            {
+                result.name = readString();
+            }
+            else if (key == "items")
+            {
+                result.items = readNumber();
+            }
+            else if (key == "samples")
+            {
+                expect('[');
+                while (! myFailed && ! peek(']'))
+                {
+                    result.samples.push_back(readNumber());
+                    if (! peek(']'))
+                    {
+                        expect(',');
+                    }
+                }
+                expect(']');
+            }
+            else
+            {
+                skipValue();
+            }
+            if (! peek('}'))
+            {
+                expect(',');
+            }
+        }
+        expect('}');
+        if (! result.samples.empty())
+        {
+            result.summarize();
+            results.push_back(result);
+        }
+    }
+
+  public:
+    /*
+     * Appends the benchmarks in the given file to results.
+     *
+     * Returns false if the file cannot be read or parsed.
+     */
+    bool read (const char * fileName, vector<BenchmarkResult>& results)
+    {
+        FILE * in = fopen(fileName, "r");
+        if (in == NULL)
+        {
+            return false;
+        }
+        string text;
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        {
+            text.append(buffer, n);
+        }
+        fclose(in);
+
+        myText = text.c_str();
+        myPos = 0;
+        myFailed = false;
+        expect('{');
+        while (! myFailed && ! peek('}'))
+        {
+            string key = readString();
+            expect(':');
+            if (key == "benchmarks")
+            {
+                expect('[');
+                while (! myFailed && ! peek(']'))
+                {
+                    readBenchmark(results);
+                    if (! peek(']'))
+                    {
+                        expect(',');
+                    }
+                }
+                expect(']');
+            }
+            else
+            {
+                skipValue();
+            }
+            if (! peek('}'))
+            {
+                expect(',');
+            }
+        }
+        expect('}');
+        return ! myFailed;
+    }
+};
+
+
+class BenchmarkRunner
+{
+  private:
+    int myWarmups;
+    int myRepetitions;
+    string myFilter;
+    vector<BenchmarkResult> myResults;
+
+    /*
+     * Returns how many calls make up one repetition, given how long
+     * one call took during warm-up.
+     */
+    static int callsPerRepetition (double elapsed)
+    {
+        if (elapsed >= MIN_REPETITION_MS)
+        {
+            return 1;
+        }
+        return int(MIN_REPETITION_MS / max(elapsed, 0.0001)) + 1;
+    }
+
+    /*
+     * Keeps a timed result, adding its samples to those of an earlier
+     * run under the same name if there was one.
+     */
+    void add (const BenchmarkResult& result)
+    {
+        for (size_t k = 0; k < myResults.size(); k++)
+        {
+            if (myResults[k].name == result.name)
+            {
+                myResults[k].samples.insert(myResults[k].samples.end(),
+                                            result.samples.begin(), result.samples.end());
+                myResults[k].summarize();
+                return;
+            }
+        }
+        myResults.push_back(result);
+    }
+
+  public:
+    // shortest time a repetition is allowed to take
+    static const double MIN_REPETITION_MS;
+
+
+    BenchmarkRunner (int warmups = 2, int repetitions = 10)
+      : myWarmups(warmups),
+        myRepetitions(repetitions)
+    {
+    }
+
+
+    /*
+     * Returns the current time in milliseconds from a monotonic clock.
+     */
+    static double now ()
+    {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+    }
+
+
+    void setRepetitions (int warmups, int repetitions)
+    {
+        myWarmups = warmups;
+        myRepetitions = repetitions;
+    }
+
+
+    /*
+     * Only benchmarks whose name contains filter will be run.
+     */
+    void setFilter (const string& filter)
+    {
+        myFilter = filter;
+    }
+
+
+    /*
+     * Returns true if a benchmark with the given name will be run, so
+     * expensive setup can be skipped otherwise.
+     */
+    bool isSelected (const string& name) const
+    {
+        return name.find(myFilter) != string::npos;
+    }
+
+
+    /*
+     * Times body(), which does the given number of items of work, and
+     * records it under name.
+     */
+    template <class Body>
+    void run (const string& name, double items, Body body)
+    {
+        run(name, items, body, myRepetitions);
+    }
+
+
+    /*
+     * As above, but with an explicit number of repetitions for
+     * benchmarks too slow to run the default number of times.
+     */
+    template <class Body>
+    void run (const string& name, double items, Body body, int repetitions)
+    {
+        if (! isSelected(name))
+        {
+            return;
+        }
+        double elapsed = 0;
+        for (int k = 0; k < max(myWarmups, 1); k++)
+        {
+            double start = now();
+            body();
+            elapsed = now() - start;
+        }
+        int calls = callsPerRepetition(elapsed);
+        BenchmarkResult result;
+        result.name = name;
+        result.items = items;
+        for (int k = 0; k < repetitions; k++)
+        {
+            double start = now();
+            for (int c = 0; c < calls; c++)
+            {
+                body();
+            }
+            result.samples.push_back((now() - start) / calls);
+        }
+        result.summarize();
+        report(result);
+        add(result);
+    }
+
+
+    /*
+     * As run(), but calls reset() untimed after every repetition so
+     * cleanup (e.g., deleting what body() built) is not measured.
+     */
+    template <class Body, class Reset>
+    void runWithReset (const string& name, double items, Body body, Reset reset,
+                       int repetitions)
+    {
+        if (! isSelected(name))
+        {
+            return;
+        }
+        double elapsed = 0;
+        for (int k = 0; k < max(myWarmups, 1); k++)
+        {
+            double start = now();
+            body();
+            elapsed = now() - start;
+            reset();
+        }
+        int calls = callsPerRepetition(elapsed);
+        BenchmarkResult result;
+        result.name = name;
+        result.items = items;
+        for (int k = 0; k < repetitions; k++)
+        {
+            double total = 0;
+            for (int c = 0; c < calls; c++)
+            {
+                double start = now();
+                body();
+                total += now() - start;
+                reset();
+            }
+            result.samples.push_back(total / calls);
+        }
+        result.summarize();
+        report(result);
+        add(result);
+    }
+
+
+    /*
+     * Records a value measured by the caller (e.g., an error bound or
+     * a count) as a single-sample result, replacing any recorded under
+     * the same name before.
+     */
+    void record (const string& name, double value)
+    {
+        if (! isSelected(name))
+        {
+            return;
+        }
+        BenchmarkResult result;
+        result.name = name;
+        result.items = 1;
+        result.samples.push_back(value);
+        result.summarize();
+        report(result);
+        for (size_t k = 0; k < myResults.size(); k++)
+        {
+            if (myResults[k].name == name)
+            {
+                myResults[k] = result;
+                return;
+            }
+        }
+        myResults.push_back(result);
+    }
+
+
+    const vector<BenchmarkResult>& getResults () const
+    {
+        return myResults;
+    }
+
+
+    /*
+     * Prints one summary row.
+     */
+    static void report (const BenchmarkResult& r)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "%-32s %10.4f %10.4f %10.4f %9.4f %10.4f %12.4g",
+                 r.name.c_str(), r.minimum, r.median, r.mean, r.stddev, r.p95,
+                 r.items / (r.median / 1000.0));
+        cout << line << endl;
+    }
+
+
+    static void printHeader ()
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "%-32s %10s %10s %10s %9s %10s %12s",
+                 "benchmark (ms per rep)", "min", "median", "mean", "stddev", "p95",
+                 "items/s");
+        cout << line << endl;
+    }
+
+
+    /*
+     * Writes every result, including the raw samples, as JSON.
+     *
+     * Returns false if the file could not be written.
+     */
+    bool writeJSON (const char * fileName) const
+    {
+        FILE * out = fopen(fileName, "w");
+        if (out == NULL)
+        {
+            return false;
+        }
+        fprintf(out, "{\n  \"unit\": \"ms\",\n  \"benchmarks\": [");
+        for (size_t k = 0; k < myResults.size(); k++)
+        {
+            const BenchmarkResult& r = myResults[k];
+            fprintf(out, "%s\n    {\"name\": \"%s\", \"items\": %.17g, "
+                         "\"min\": %.6g, \"median\": %.6g, \"mean\": %.6g, "
+                         "\"stddev\": %.6g, \"p95\": %.6g, \"max\": %.6g, \"samples\": [",
+                    (k == 0) ? "" : ",", r.name.c_str(), r.items, r.minimum,
+                    r.median, r.mean, r.stddev, r.p95, r.maximum);
+            for (size_t s = 0; s < r.samples.size(); s++)
+            {
+                fprintf(out, "%s%.6g", (s == 0) ? "" : ", ", r.samples[s]);
+            }
+            fprintf(out, "]}");
+        }
+        fprintf(out, "\n  ]\n}\n");
+        return fclose(out) == 0;
+    }
+};
+
+const double BenchmarkRunner::MIN_REPETITION_MS = 5;
+
+#endif
@@ -0,0 +1,84 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines the per-tick state of every body as separate
+// arrays (structure of arrays), indexed in catalog order, so it can
+// be copied, shared or processed in bulk without walking objects.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef BODY_STATE_H_
+#define BODY_STATE_H_
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+/*
+ * What kind of object each body is.
+ */
+enum BodyKind
+{
+    KIND_SUN,
+    KIND_PLANET,
+    KIND_MOON,
+    NUM_BODY_KINDS
+};
+
+
+/*
+ * The part of a body that changes as it is animated, kept apart from
+ * the rest so every body's can be saved or restored in one copy.
+ */
+struct BodyMotion
+{
+    // degrees, in [0, 360)
+    double orbitAngle, rotationAngle;
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+struct BodyState
+{
+    // simulation tick this state belongs to
+    uint64_t tick;
+    // catalog position of each body
+    vector<uint32_t> ids;
+    // world position of each body's center
+    vector<double> x, y, z;
+    // angles in degrees, as animated (wrapped into [0, 360))
+    vector<double> orbitAngles, rotationAngles;
+
+
+    BodyState ()
+      : tick(0)
+    {
+    }
+
+
+    int size () const
+    {
+        return int(ids.size());
+    }
+
+
+    void resize (int count)
+    {
+        ids.resize(count);
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        orbitAngles.resize(count);
+        rotationAngles.resize(count);
+        for (int k = 0; k < count; k++)
+        {
+            ids[k] = k;
+        }
+    }
+};
+
+#endif
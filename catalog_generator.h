@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file writes synthetic catalogs in the SolarSystem.txt
+// format, so large scenes can be loaded for benchmarking and
+// testing without shipping huge data files.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef CATALOG_GENERATOR_H_
+#define CATALOG_GENERATOR_H_
+
+#include <cstdio>            // for snprintf
+#include <iostream>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class CatalogGenerator
+{
+  private:
+    unsigned int mySeed;
+
+    // small deterministic generator so catalogs are identical everywhere
+    double nextDouble (double low, double high)
+    {
+        mySeed = mySeed * 1664525u + 1013904223u;
+        return low + (high - low) * (mySeed >> 8) / double(1 << 24);
+    }
+
+  public:
+    // bodies orbiting each planet, including the planet itself
+    static const int SYSTEM_SIZE = 100;
+
+
+    CatalogGenerator (unsigned int seed = 1)
+      : mySeed(seed)
+    {
+    }
+
+
+    /*
+     * Writes a catalog of numBodies objects: one sun, a planet for
+     * every SYSTEM_SIZE bodies and moons around those planets.
+     */
+    void write (ostream& out, int numBodies)
+    {
+        char line[256];
+        out << "*Type; Name; rotation speed; distance from center of orbit; "
+               "what it is orbiting around; rotation axis; size; orbit axis; "
+               "orbit tilt angle; rotation tilt angle; orbit speed\n";
+        out << "Sun; Sun1; 15; 0; none; 0 1 0; 3; 0 0 0; 0; 0; 0\n";
+        int numPlanets = (numBodies - 1 + SYSTEM_SIZE - 1) / SYSTEM_SIZE;
+        int written = 1;
+        for (int p = 1; p <= numPlanets && written < numBodies; p++)
+        {
+            double planetSize = nextDouble(0.2, 1.5);
+            snprintf(line, sizeof(line),
+                     "Planet; Planet%d; %.3f; %.3f; Sun1; 0 1 0; %.3f; 1 0 0; %.2f; %.2f; %.3f\n",
+                     p, nextDouble(-6, 6), 6 + 4.0 * p, planetSize,
+                     nextDouble(-15, 15), nextDouble(-40, 40), nextDouble(-6, 6));
+            out << line;
+            written++;
+            for (int m = 1; m < SYSTEM_SIZE && written < numBodies; m++)
+            {
+                snprintf(line, sizeof(line),
+                         "Moon; Moon%d_%d; %.3f; %.3f; Planet%d; 0.2 1 0.3; %.3f; 0 0 1; %.2f; %.2f; %.3f\n",
+                         p, m, nextDouble(-4, 4), planetSize + 0.3 + 0.05 * m, p,
+                         nextDouble(0.02, 0.1), nextDouble(-30, 30),
+                         nextDouble(-20, 20), nextDouble(-5, 5));
+                out << line;
+                written++;
+            }
+        }
+    }
+};
+
+#endif
@@ -19,6 +19,10 @@
   #endif
     using namespace cglx;
 #else
+  // declare buffer and framebuffer object entry points
+  #ifndef GL_GLEXT_PROTOTYPES
+    #define GL_GLEXT_PROTOTYPES
+  #endif
   #ifdef __APPLE__
     #include <GLUT/glut.h>
   #else
@@ -0,0 +1,821 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines how one master process shares its simulation
+// with render-only node processes, so the nodes of a wall draw the
+// same state instead of each simulating (and drifting) on its own.
+//
+// Every tick the master sends each node the camera and every
+// body's orbit and rotation angles.  Angles are quantized to 2^32
+// steps per turn and each value is predicted from the previous two
+// ticks (constant angular speed), so only the prediction error is
+// sent, as zero runs and zig-zag varints: a steadily moving scene
+// costs a few bytes per tick.  Keyframes (prediction from zero) are
+// sent when a node joins.  After drawing, nodes report ready and
+// swap together when the master says so (a swap barrier).
+//
+// Addresses are "unix:/path/to/socket" for UNIX domain sockets or
+// "host:port" for TCP.  Values are sent in host byte order, so all
+// processes must run on the same kind of machine.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef CLUSTER_H_
+#define CLUSTER_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <cstring>           // for memcpy
+#include <cstdio>            // for snprintf
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unistd.h>          // for close, unlink
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>           // for getaddrinfo
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>     // for TCP_NODELAY
+#include "scene.h"
+#include "trace.h"
+
+using namespace std;
+
+/*
+ * Kinds of messages, each sent as [type: 1 byte][length: 4 bytes][payload].
+ */
+enum ClusterMessage
+{
+    MESSAGE_STATE = 1,       // master to node: tick, flags, camera, angles
+    MESSAGE_READY = 2,       // node to master: tick drawn, waiting to swap
+    MESSAGE_SWAP = 3         // master to node: swap now
+};
+
+// flags in a state message
+const unsigned char STATE_KEYFRAME = 1;
+const unsigned char STATE_CAMERA = 2;
+const unsigned char STATE_SHOW_ORBIT = 4;
+
+
+/*
+ * Encodes and decodes arrays of quantized angles against the
+ * previous ticks.  An encoder and its decoder keep identical
+ * history, so they must see the same sequence of arrays.
+ */
+class StateCodec
+{
+  private:
+    vector<uint32_t> myPrevious;
+    vector<uint32_t> myBeforePrevious;
+    int myHistory;           // ticks of history available (0 to 2)
+
+    uint32_t predict (size_t k) const
+    {
+        if (myHistory == 0)
+        {
+            return 0;
+        }
+        if (myHistory == 1)
+        {
+            return myPrevious[k];
+        }
+        return 2 * myPrevious[k] - myBeforePrevious[k];
+    }
+
+    void remember (const uint32_t * values, size_t count)
+    {
+        myBeforePrevious.swap(myPrevious);
+        myPrevious.assign(values, values + count);
+        if (myHistory < 2)
+        {
+            myHistory++;
+        }
+    }
+
+    static void putVarint (vector<unsigned char>& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((unsigned char)value);
+    }
+
+    static bool getVarint (const unsigned char *& in, const unsigned char * end, uint32_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35 && in < end; shift += 7)
+        {
+            unsigned char byte = *in++;
+            value |= uint32_t(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  public:
+    StateCodec () : myHistory(0) {}
+
+
+    /*
+     * Forgets all history, so the next array is encoded as a keyframe.
+     */
+    void reset ()
+    {
+        myHistory = 0;
+    }
+
+
+    static uint32_t quantize (double degrees)
+    {
+        double turns = degrees / 360.0;
+        turns -= floor(turns);
+        return uint32_t(uint64_t(llround(turns * 4294967296.0)));
+    }
+
+
+    static double dequantize (uint32_t value)
+    {
+        return value * (360.0 / 4294967296.0);
+    }
+
+
+    /*
+     * Appends the encoding of count values to out.
+     */
+    void encode (const uint32_t * values, size_t count, vector<unsigned char>& out)
+    {
+        if (myPrevious.size() != count)
+        {
+            myHistory = 0;
+        }
+        uint32_t zeros = 0;
+        for (size_t k = 0; k < count; k++)
+        {
+            int32_t residual = int32_t(values[k] - predict(k));
+            if (residual == 0)
+            {
+                zeros++;
+            }
+            else
+            {
+                putVarint(out, zeros);
+                putVarint(out, (uint32_t(residual) << 1) ^ uint32_t(residual >> 31));
+                zeros = 0;
+            }
+        }
+        if (zeros > 0)
+        {
+            putVarint(out, zeros);
+        }
+        remember(values, count);
+    }
+
+
+    /*
+     * Decodes count values from [in, end), advancing in.
+     *
+     * Returns false if the data is malformed.
+     */
+    bool decode (const unsigned char *& in, const unsigned char * end,
+                 uint32_t * values, size_t count)
+    {
+        if (myPrevious.size() != count)
+        {
+            myHistory = 0;
+        }
+        size_t k = 0;
+        while (k < count)
+        {
+            uint32_t zeros, zigzag;
+            if (! getVarint(in, end, zeros) || zeros > count - k)
+            {
+                return false;
+            }
+            for (uint32_t z = 0; z < zeros; z++, k++)
+            {
+                values[k] = predict(k);
+            }
+            if (k == count)
+            {
+                break;
+            }
+            if (! getVarint(in, end, zigzag))
+            {
+                return false;
+            }
+            int32_t residual = int32_t((zigzag >> 1) ^ (0u - (zigzag & 1)));
+            values[k] = predict(k) + uint32_t(residual);
+            k++;
+        }
+        remember(values, count);
+        return true;
+    }
+};
+
+
+/*
+ * Socket helpers shared by master and nodes.
+ */
+class ClusterSocket
+{
+  public:
+    /*
+     * Returns a listening socket for address, or -1.
+     */
+    static int listenOn (const string& address)
+    {
+        if (address.compare(0, 5, "unix:") == 0)
+        {
+            sockaddr_un local;
+            if (! unixAddress(address.substr(5), local))
+            {
+                return -1;
+            }
+            unlink(local.sun_path);
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || bind(fd, (sockaddr *)&local, sizeof(local)) < 0 || ::listen(fd, 64) < 0)
+            {
+                closeSocket(fd);
+                return -1;
+            }
+            return fd;
+        }
+        addrinfo * info = resolve(address, true);
+        if (info == NULL)
+        {
+            return -1;
+        }
+        int fd = socket(info->ai_family, SOCK_STREAM, 0);
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        if (fd < 0 || bind(fd, info->ai_addr, info->ai_addrlen) < 0 || ::listen(fd, 64) < 0)
+        {
+            closeSocket(fd);
+            fd = -1;
+        }
+        freeaddrinfo(info);
+        return fd;
+    }
+
+
+    /*
+     * Returns a socket connected to address, or -1.
+     */
+    static int connectTo (const string& address)
+    {
+        int fd = -1;
+        if (address.compare(0, 5, "unix:") == 0)
+        {
+            sockaddr_un remote;
+            if (unixAddress(address.substr(5), remote))
+            {
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (fd >= 0 && ::connect(fd, (sockaddr *)&remote, sizeof(remote)) < 0)
+                {
+                    closeSocket(fd);
+                    fd = -1;
+                }
+            }
+            return fd;
+        }
+        addrinfo * info = resolve(address, false);
+        if (info != NULL)
+        {
+            fd = socket(info->ai_family, SOCK_STREAM, 0);
+            if (fd >= 0 && ::connect(fd, info->ai_addr, info->ai_addrlen) < 0)
+            {
+                closeSocket(fd);
+                fd = -1;
+            }
+            freeaddrinfo(info);
+        }
+        noDelay(fd);
+        return fd;
+    }
+
+
+    /*
+     * Sends small messages immediately on TCP sockets.
+     */
+    static void noDelay (int fd)
+    {
+        int yes = 1;
+        if (fd >= 0)
+        {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        }
+    }
+
+
+    static void closeSocket (int fd)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+
+    /*
+     * Returns true if fd has data within timeoutMs milliseconds.
+     */
+    static bool waitReadable (int fd, int timeoutMs)
+    {
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        return poll(&p, 1, timeoutMs) > 0;
+    }
+
+
+    static bool sendMessage (int fd, unsigned char type, const unsigned char * payload, uint32_t length)
+    {
+        unsigned char header[5];
+        header[0] = type;
+        memcpy(header + 1, &length, 4);
+        return sendAll(fd, header, 5) && (length == 0 || sendAll(fd, payload, length));
+    }
+
+
+    /*
+     * Reads one whole message; returns false if the connection failed.
+     */
+    static bool receiveMessage (int fd, unsigned char& type, vector<unsigned char>& payload)
+    {
+        unsigned char header[5];
+        if (! receiveAll(fd, header, 5))
+        {
+            return false;
+        }
+        uint32_t length;
+        type = header[0];
+        memcpy(&length, header + 1, 4);
+        payload.resize(length);
+        return length == 0 || receiveAll(fd, &payload[0], length);
+    }
+
+  private:
+    static bool unixAddress (const string& path, sockaddr_un& address)
+    {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            return false;
+        }
+        strcpy(address.sun_path, path.c_str());
+        return true;
+    }
+
+    static addrinfo * resolve (const string& address, bool passive)
+    {
+        size_t colon = address.rfind(':');
+        string host = (colon == string::npos) ? "" : address.substr(0, colon);
+        string port = (colon == string::npos) ? address : address.substr(colon + 1);
+        addrinfo hints, * info = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        if (getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &info) != 0)
+        {
+            return NULL;
+        }
+        return info;
+    }
+
+    static bool sendAll (int fd, const unsigned char * data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+            if (sent <= 0)
+            {
+                return false;
+            }
+            data += sent;
+            length -= sent;
+        }
+        return true;
+    }
+
+    static bool receiveAll (int fd, unsigned char * data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t received = recv(fd, data, length, 0);
+            if (received <= 0)
+            {
+                return false;
+            }
+            data += received;
+            length -= received;
+        }
+        return true;
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+/*
+ * Runs the simulation and sends its state to render nodes.
+ */
+class ClusterMaster
+{
+  private:
+    int myListener;
+    vector<int> myNodes;
+    StateCodec myCodec;
+    bool myNeedsKeyframe;
+    uint32_t myTick;
+    bool isAwaitingSwap;
+    double myCamera[9];
+    vector<double> myOrbitAngles, myRotationAngles;
+    vector<uint32_t> myValues;
+    vector<unsigned char> myMessage;
+    // bytes of state sent to one node, and ticks sent, since the last report
+    double myBytes;
+    int myTicks;
+    int myBodyCount;
+
+    void dropNode (size_t k)
+    {
+        cerr << "Cluster: lost a render node" << endl;
+        ClusterSocket::closeSocket(myNodes[k]);
+        myNodes.erase(myNodes.begin() + k);
+    }
+
+  public:
+    // ticks between bytes/tick reports
+    static const int REPORT_INTERVAL = 250;
+    // longest wait for a node at the swap barrier
+    static const int SWAP_TIMEOUT_MS = 1000;
+
+
+    ClusterMaster ()
+      : myListener(-1),
+        myNeedsKeyframe(true),
+        myTick(0),
+        isAwaitingSwap(false),
+        myBytes(0),
+        myTicks(0),
+        myBodyCount(0)
+    {
+    }
+
+
+    ~ClusterMaster ()
+    {
+        for (size_t k = 0; k < myNodes.size(); k++)
+        {
+            ClusterSocket::closeSocket(myNodes[k]);
+        }
+        ClusterSocket::closeSocket(myListener);
+    }
+
+
+    /*
+     * Starts accepting nodes at address; returns false on failure.
+     */
+    bool listen (const string& address)
+    {
+        myListener = ClusterSocket::listenOn(address);
+        if (myListener < 0)
+        {
+            return false;
+        }
+        fcntl(myListener, F_SETFL, O_NONBLOCK);
+        return true;
+    }
+
+
+    /*
+     * Accepts any waiting nodes without blocking; new nodes get a
+     * keyframe with the next state.
+     */
+    void acceptNodes ()
+    {
+        int fd;
+        while ((fd = accept(myListener, NULL, NULL)) >= 0)
+        {
+            ClusterSocket::noDelay(fd);
+            myNodes.push_back(fd);
+            myNeedsKeyframe = true;
+            cout << "Cluster: " << myNodes.size() << " render node(s) connected" << endl;
+        }
+    }
+
+
+    int getNodeCount () const
+    {
+        return int(myNodes.size());
+    }
+
+
+    /*
+     * Sends the scene's current state to every node.
+     */
+    void broadcast (Scene * scene)
+    {
+        TRACE_SCOPE("ClusterMaster::broadcast");
+        if (myNodes.empty())
+        {
+            return;
+        }
+        SolarSystem * system = scene->getSolarSystem();
+        int count = system->getBodyCount();
+        myOrbitAngles.resize(count);
+        myRotationAngles.resize(count);
+        myValues.resize(2 * count);
+        system->getAngles(&myOrbitAngles[0], &myRotationAngles[0]);
+        for (int k = 0; k < count; k++)
+        {
+            myValues[2 * k] = StateCodec::quantize(myOrbitAngles[k]);
+            myValues[2 * k + 1] = StateCodec::quantize(myRotationAngles[k]);
+        }
+
+        double camera[9];
+        scene->getCameraState(camera);
+        unsigned char flags = system->isOrbitShown() ? STATE_SHOW_ORBIT : 0;
+        if (myNeedsKeyframe || count != myBodyCount)
+        {
+            flags |= STATE_KEYFRAME | STATE_CAMERA;
+            myCodec.reset();
+            myNeedsKeyframe = false;
+            myBodyCount = count;
+        }
+        else if (memcmp(camera, myCamera, sizeof(camera)) != 0)
+        {
+            flags |= STATE_CAMERA;
+        }
+        memcpy(myCamera, camera, sizeof(camera));
+
+        myTick++;
+        myMessage.resize(4);
+        memcpy(&myMessage[0], &myTick, 4);
+        myMessage.push_back(flags);
+        if (flags & STATE_CAMERA)
+        {
+            const unsigned char * bytes = (const unsigned char *)camera;
+            myMessage.insert(myMessage.end(), bytes, bytes + sizeof(camera));
+        }
+        uint32_t bodies = count;
+        const unsigned char * bodyBytes = (const unsigned char *)&bodies;
+        myMessage.insert(myMessage.end(), bodyBytes, bodyBytes + 4);
+        myCodec.encode(&myValues[0], myValues.size(), myMessage);
+
+        for (size_t k = myNodes.size(); k-- > 0; )
+        {
+            if (! ClusterSocket::sendMessage(myNodes[k], MESSAGE_STATE, &myMessage[0], myMessage.size()))
+            {
+                dropNode(k);
+            }
+        }
+        isAwaitingSwap = ! myNodes.empty();
+        myBytes += myMessage.size() + 5;
+        myTicks++;
+        if (myTicks == REPORT_INTERVAL)
+        {
+            report(cout);
+        }
+    }
+
+
+    /*
+     * Waits until every node has drawn the last state, then tells them
+     * all to swap.  Call just before swapping the master's own buffers.
+     */
+    void swapBarrier ()
+    {
+        TRACE_SCOPE("ClusterMaster::swapBarrier");
+        if (! isAwaitingSwap)
+        {
+            return;
+        }
+        isAwaitingSwap = false;
+        vector<unsigned char> payload;
+        for (size_t k = myNodes.size(); k-- > 0; )
+        {
+            unsigned char type = 0;
+            uint32_t tick = 0;
+            // skip acknowledgements of older ticks
+            while (type != MESSAGE_READY || tick != myTick)
+            {
+                if (! ClusterSocket::waitReadable(myNodes[k], SWAP_TIMEOUT_MS) ||
+                    ! ClusterSocket::receiveMessage(myNodes[k], type, payload) ||
+                    payload.size() < 4)
+                {
+                    break;
+                }
+                memcpy(&tick, &payload[0], 4);
+            }
+            if (type != MESSAGE_READY || tick != myTick)
+            {
+                dropNode(k);
+            }
+        }
+        for (size_t k = myNodes.size(); k-- > 0; )
+        {
+            if (! ClusterSocket::sendMessage(myNodes[k], MESSAGE_SWAP,
+                                             (const unsigned char *)&myTick, 4))
+            {
+                dropNode(k);
+            }
+        }
+    }
+
+
+    /*
+     * Prints the average bytes of state sent per tick since the last report.
+     */
+    void report (ostream& out)
+    {
+        if (myTicks == 0)
+        {
+            return;
+        }
+        char line[160];
+        snprintf(line, sizeof(line),
+                 "Cluster: %d node(s), %.1f bytes/tick per node (%d bytes unencoded), %.1f total",
+                 getNodeCount(), myBytes / myTicks, 16 * myBodyCount + 72,
+                 myBytes / myTicks * getNodeCount());
+        out << line << endl;
+        myBytes = 0;
+        myTicks = 0;
+    }
+};
+
+
+/*
+ * Draws the state received from a master instead of simulating.
+ */
+class ClusterNode
+{
+  private:
+    int mySocket;
+    StateCodec myCodec;
+    uint32_t myTick;
+    bool isAwaitingSwap;
+    vector<unsigned char> myPayload;
+    vector<uint32_t> myValues;
+    vector<double> myOrbitAngles, myRotationAngles;
+
+    bool applyState (Scene * scene)
+    {
+        const unsigned char * in = &myPayload[0];
+        const unsigned char * end = in + myPayload.size();
+        if (end - in < 5)
+        {
+            return false;
+        }
+        memcpy(&myTick, in, 4);
+        unsigned char flags = in[4];
+        in += 5;
+        if (flags & STATE_CAMERA)
+        {
+            if (end - in < 72)
+            {
+                return false;
+            }
+            double camera[9];
+            memcpy(camera, in, sizeof(camera));
+            scene->setCameraState(camera);
+            in += sizeof(camera);
+        }
+        uint32_t count;
+        if (end - in < 4)
+        {
+            return false;
+        }
+        memcpy(&count, in, 4);
+        in += 4;
+        if (flags & STATE_KEYFRAME)
+        {
+            myCodec.reset();
+        }
+        myValues.resize(2 * count);
+        if (! myCodec.decode(in, end, &myValues[0], myValues.size()))
+        {
+            return false;
+        }
+
+        SolarSystem * system = scene->getSolarSystem();
+        if (int(count) != system->getBodyCount())
+        {
+            cerr << "Cluster: master has " << count << " bodies, this node has "
+                 << system->getBodyCount() << endl;
+            return false;
+        }
+        myOrbitAngles.resize(count);
+        myRotationAngles.resize(count);
+        for (uint32_t k = 0; k < count; k++)
+        {
+            myOrbitAngles[k] = StateCodec::dequantize(myValues[2 * k]);
+            myRotationAngles[k] = StateCodec::dequantize(myValues[2 * k + 1]);
+        }
+        system->setAngles(&myOrbitAngles[0], &myRotationAngles[0]);
+        scene->refresh();
+        if (system->isOrbitShown() != ((flags & STATE_SHOW_ORBIT) != 0))
+        {
+            system->toggleOrbit((flags & STATE_SHOW_ORBIT) != 0);
+        }
+        return true;
+    }
+
+  public:
+    ClusterNode ()
+      : mySocket(-1),
+        myTick(0),
+        isAwaitingSwap(false)
+    {
+    }
+
+
+    ~ClusterNode ()
+    {
+        ClusterSocket::closeSocket(mySocket);
+    }
+
+
+    /*
+     * Connects to the master at address; returns false on failure.
+     */
+    bool connect (const string& address)
+    {
+        mySocket = ClusterSocket::connectTo(address);
+        return mySocket >= 0;
+    }
+
+
+    bool isConnected () const
+    {
+        return mySocket >= 0;
+    }
+
+
+    /*
+     * Waits up to timeoutMs for the next state and applies it to scene.
+     *
+     * Returns true if the scene changed and should be redrawn.
+     */
+    bool receive (Scene * scene, int timeoutMs)
+    {
+        TRACE_SCOPE("ClusterNode::receive");
+        if (mySocket < 0 || ! ClusterSocket::waitReadable(mySocket, timeoutMs))
+        {
+            return false;
+        }
+        unsigned char type;
+        if (! ClusterSocket::receiveMessage(mySocket, type, myPayload))
+        {
+            cerr << "Cluster: lost the master" << endl;
+            ClusterSocket::closeSocket(mySocket);
+            mySocket = -1;
+            return false;
+        }
+        if (type != MESSAGE_STATE || ! applyState(scene))
+        {
+            return false;
+        }
+        isAwaitingSwap = true;
+        return true;
+    }
+
+
+    /*
+     * Reports the last state as drawn and waits for the master's
+     * signal to swap.  Call just before swapping buffers.
+     */
+    void swapBarrier ()
+    {
+        TRACE_SCOPE("ClusterNode::swapBarrier");
+        if (! isAwaitingSwap || mySocket < 0)
+        {
+            return;
+        }
+        isAwaitingSwap = false;
+        if (! ClusterSocket::sendMessage(mySocket, MESSAGE_READY, (const unsigned char *)&myTick, 4))
+        {
+            return;
+        }
+        unsigned char type = 0;
+        while (type != MESSAGE_SWAP &&
+               ClusterSocket::waitReadable(mySocket, ClusterMaster::SWAP_TIMEOUT_MS) &&
+               ClusterSocket::receiveMessage(mySocket, type, myPayload))
+        {
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a reusable barrier for groups of threads that
+// work on the same frame in lock step.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef FRAME_BARRIER_H_
+#define FRAME_BARRIER_H_
+
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+/*
+ * Blocks each arriving thread until the given number have arrived.
+ */
+class FrameBarrier
+{
+  private:
+    mutex myLock;
+    condition_variable myCondition;
+    int myParties;
+    int myWaiting;
+    unsigned int myGeneration;
+
+  public:
+    FrameBarrier (int parties = 1)
+      : myParties(parties),
+        myWaiting(0),
+        myGeneration(0)
+    {
+    }
+
+    void reset (int parties)
+    {
+        unique_lock<mutex> guard(myLock);
+        myParties = parties;
+        myWaiting = 0;
+    }
+
+    void wait ()
+    {
+        unique_lock<mutex> guard(myLock);
+        unsigned int generation = myGeneration;
+        if (++myWaiting == myParties)
+        {
+            myWaiting = 0;
+            myGeneration++;
+            myCondition.notify_all();
+        }
+        else
+        {
+            while (generation == myGeneration)
+            {
+                myCondition.wait(guard);
+            }
+        }
+    }
+};
+
+#endif
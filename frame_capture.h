@@ -0,0 +1,317 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines screenshot and video capture for the viewer
+// that does not stall rendering.  Each captured frame is read into
+// one of two pixel buffer objects without waiting; the previous
+// frame's buffer, which the GPU has had a whole frame to fill, is
+// then copied out and handed to an encoder thread.  If the encoder
+// falls behind, recorded frames are dropped (and counted) instead
+// of making the viewer wait.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef FRAME_CAPTURE_H_
+#define FRAME_CAPTURE_H_
+
+#include <cstdio>            // for snprintf
+#include <cstring>           // for memcpy
+#include <string>
+#include <iostream>
+#include "cglx.h"
+#include "image_writer.h"
+#include "trace.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class FrameCapture
+{
+  private:
+    ImageWriter myWriter;
+    GLuint myBuffers[2];
+    int myWidth, myHeight;
+    // buffer the next frame is read into
+    int myCurrent;
+    // files each buffer's frame goes to; empty if it holds none
+    string myShotNames[2];
+    string myRecordNames[2];
+    bool isShotRequested;
+    bool isRecording;
+    string myScreenshotPattern;
+    string myRecordPattern;
+    string myRecordName;
+    int myNumShots;
+    int myNumRecordings;
+    int myNumRecorded;
+    int myNumDropped;
+    char myFileName[1024];
+
+    /*
+     * Copies a finished buffer out to the encoder.  Recorded frames
+     * are dropped if the encoder has no free buffer; screenshots wait.
+     */
+    void finishRead (int buffer)
+    {
+        TRACE_SCOPE("FrameCapture::finishRead");
+        ImageFrame * shot = NULL, * recorded = NULL;
+        if (! myShotNames[buffer].empty())
+        {
+            shot = myWriter.acquire(myWidth, myHeight);
+        }
+        if (! myRecordNames[buffer].empty())
+        {
+            recorded = myWriter.tryAcquire(myWidth, myHeight);
+            if (recorded == NULL)
+            {
+                myNumDropped++;
+            }
+        }
+        if (shot != NULL || recorded != NULL)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, myBuffers[buffer]);
+            const void * pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+            if (pixels != NULL)
+            {
+                size_t size = size_t(myWidth) * myHeight * 4;
+                if (shot != NULL)
+                {
+                    memcpy(&shot->pixels[0], pixels, size);
+                    myWriter.submit(shot, myShotNames[buffer].c_str());
+                    cout << "Saved " << myShotNames[buffer] << endl;
+                }
+                if (recorded != NULL)
+                {
+                    memcpy(&recorded->pixels[0], pixels, size);
+                    myWriter.submit(recorded, myRecordNames[buffer].c_str());
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        myShotNames[buffer].clear();
+        myRecordNames[buffer].clear();
+    }
+
+    bool isPending (int buffer) const
+    {
+        return ! myShotNames[buffer].empty() || ! myRecordNames[buffer].empty();
+    }
+
+    /*
+     * Completes any reads in flight, e.g., before buffers are resized.
+     */
+    void finishReads ()
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            int buffer = (myCurrent + k) % 2;
+            if (isPending(buffer))
+            {
+                finishRead(buffer);
+            }
+        }
+    }
+
+    bool hasExtension (const string& name, const char * extension) const
+    {
+        return ImageWriter::hasExtension(name, extension);
+    }
+
+  public:
+    // encoder buffers; recorded frames are dropped when all are in use
+    static const int NUM_FRAMES = 4;
+
+
+    FrameCapture ()
+      : myWidth(0),
+        myHeight(0),
+        myCurrent(0),
+        isShotRequested(false),
+        isRecording(false),
+        myScreenshotPattern("screenshot_%03d.png"),
+        myRecordPattern("capture_%02d.y4m"),
+        myNumShots(0),
+        myNumRecordings(0),
+        myNumRecorded(0),
+        myNumDropped(0)
+    {
+        myBuffers[0] = myBuffers[1] = 0;
+    }
+
+
+    /*
+     * Sets printf patterns for screenshot files (given the screenshot
+     * number) and recordings (given the recording number, then, for
+     * .png or .ppm sequences, the frame number).
+     */
+    void setPatterns (const string& screenshots, const string& recordings)
+    {
+        myScreenshotPattern = screenshots;
+        myRecordPattern = recordings;
+    }
+
+
+    void setFrameRate (int framesPerSecond)
+    {
+        myWriter.setFrameRate(framesPerSecond);
+    }
+
+
+    /*
+     * Saves the next frame drawn.
+     */
+    void requestScreenshot ()
+    {
+        isShotRequested = true;
+    }
+
+
+    /*
+     * Starts or stops saving every frame drawn.
+     */
+    void toggleRecording ()
+    {
+        isRecording = ! isRecording;
+        if (isRecording)
+        {
+            myNumRecordings++;
+            myNumRecorded = 0;
+            myNumDropped = 0;
+            snprintf(myFileName, sizeof(myFileName), myRecordPattern.c_str(), myNumRecordings, 0);
+            myRecordName = myFileName;
+            cout << "Recording to " << myRecordName << endl;
+        }
+        else
+        {
+            finishReads();
+            report(cout);
+        }
+    }
+
+
+    bool isActive () const
+    {
+        return isShotRequested || isRecording || isPending(0) || isPending(1);
+    }
+
+
+    /*
+     * Starts reading the frame just drawn (in the current read buffer)
+     * and passes the previous one to the encoder.  Call after drawing
+     * and before swapping buffers.
+     */
+    void capture (int width, int height)
+    {
+        if (! isActive())
+        {
+            return;
+        }
+        TRACE_SCOPE("FrameCapture::capture");
+        if (myBuffers[0] == 0)
+        {
+            glGenBuffers(2, myBuffers);
+            myWriter.start(1, NUM_FRAMES);
+        }
+        if (width != myWidth || height != myHeight)
+        {
+            finishReads();
+            myWidth = width;
+            myHeight = height;
+            for (int k = 0; k < 2; k++)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, myBuffers[k]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, size_t(width) * height * 4, NULL, GL_STREAM_READ);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        if (isShotRequested || isRecording)
+        {
+            if (isShotRequested)
+            {
+                snprintf(myFileName, sizeof(myFileName), myScreenshotPattern.c_str(), ++myNumShots);
+                myShotNames[myCurrent] = myFileName;
+                isShotRequested = false;
+            }
+            if (isRecording)
+            {
+                if (hasExtension(myRecordPattern, ".png") || hasExtension(myRecordPattern, ".ppm"))
+                {
+                    snprintf(myFileName, sizeof(myFileName), myRecordPattern.c_str(),
+                             myNumRecordings, myNumRecorded);
+                    myRecordNames[myCurrent] = myFileName;
+                }
+                else
+                {
+                    myRecordNames[myCurrent] = myRecordName;
+                }
+                myNumRecorded++;
+            }
+
+            // returns at once; the copy happens while the next frame is drawn
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, myBuffers[myCurrent]);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        myCurrent = 1 - myCurrent;
+        if (isPending(myCurrent))
+        {
+            finishRead(myCurrent);
+        }
+    }
+
+
+    /*
+     * Saves anything in flight and waits for the encoder to finish.
+     */
+    void stop ()
+    {
+        if (myBuffers[0] != 0)
+        {
+            finishReads();
+            if (isRecording)
+            {
+                report(cout);
+            }
+            myWriter.finish();
+        }
+    }
+
+
+    /*
+     * Prints how many frames of the current recording were kept and
+     * dropped.
+     */
+    void report (ostream& out)
+    {
+        out << "Recorded " << myNumRecorded - myNumDropped << " frames to " << myRecordName
+            << ", dropped " << myNumDropped << endl;
+    }
+
+
+    /*
+     * Adds the encoder's buffers and the two pixel buffer objects to
+     * report, under "recorders".
+     */
+    void reportMemory (MemoryReport& report)
+    {
+        myWriter.reportMemory(report);
+        if (myBuffers[0] != 0)
+        {
+            report.add("recorders", 2 * size_t(myWidth) * myHeight * 4, 2);
+        }
+    }
+
+
+    int getNumDropped () const
+    {
+        return myNumDropped;
+    }
+};
+
+#endif
@@ -0,0 +1,468 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a per-phase frame profiler.  Each frame is
+// split into simulate, camera, cull, draw and swap phases that
+// are timed separately with a monotonic clock.  A rolling window
+// of recent frames provides p50/p95/p99 figures per phase, which
+// can be drawn as an on-screen HUD, and a longer per-frame history
+// can be written as CSV (typically when the program exits).  Both are
+// fixed in size, so profiling a frame never allocates however long the
+// program runs.
+// Frames can also count events, such as draw calls, which are kept
+// alongside the timings, and the heap allocations the profiling
+// thread made in each phase (see alloc_counter.h).
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef FRAME_PROFILER_H_
+#define FRAME_PROFILER_H_
+
+#include <time.h>            // clock_gettime
+#include <cstdio>            // for fopen, snprintf
+#include <vector>
+#include <algorithm>         // for sort
+#include <iostream>
+#include "cglx.h"
+#include "alloc_counter.h"
+#include "memory_report.h"
+
+using namespace std;
+
+/*
+ * Phases of a frame, in the order they normally happen.  The camera
+ * phase only sets up the view; the bodies' world positions are found
+ * as culling and drawing need them, so their cost shows up there.
+ */
+enum FramePhase
+{
+    PHASE_SIMULATE,
+    PHASE_CAMERA,
+    PHASE_CULL,
+    PHASE_DRAW,
+    PHASE_SWAP,
+    NUM_FRAME_PHASES
+};
+
+
+/*
+ * Events counted per frame.
+ */
+enum FrameCounter
+{
+    COUNTER_DRAW_CALLS,
+    COUNTER_STATE_CHANGES,
+    COUNTER_IMPOSTORS,
+    COUNTER_OCCLUDED,
+    // by the profiling thread over the whole frame
+    COUNTER_ALLOCATIONS,
+    NUM_FRAME_COUNTERS
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class FrameProfiler
+{
+  public:
+    // frames kept for the rolling percentiles
+    static const int WINDOW_SIZE = 256;
+    // frames kept for the CSV (over 4 minutes at 60 fps); older ones
+    // are overwritten
+    static const int HISTORY_SIZE = 16384;
+    // percentiles reported per phase
+    static const int NUM_PERCENTILES = 3;
+
+  private:
+    // one row of the history (durations in milliseconds)
+    struct FrameSample
+    {
+        double phase[NUM_FRAME_PHASES];
+        double total;
+        long counters[NUM_FRAME_COUNTERS];
+        long allocations[NUM_FRAME_PHASES];
+    };
+
+    double myPhaseStart[NUM_FRAME_PHASES];
+    long myPhaseAllocations[NUM_FRAME_PHASES];
+    FrameSample myCurrent;
+    // rolling window, stored as a ring buffer
+    FrameSample myWindow[WINDOW_SIZE];
+    int myWindowHead;
+    int myWindowCount;
+    // cached percentiles, [phase or total][p50, p95, p99]
+    double mySummary[NUM_FRAME_PHASES + 1][NUM_PERCENTILES];
+    // one phase of the window at a time, reordered to find percentiles
+    double mySamples[WINDOW_SIZE];
+    // the last HISTORY_SIZE frames, filled up to its reserved size and
+    // then used as a ring buffer, and how many frames were ever committed
+    vector<FrameSample> myHistory;
+    long myNumFrames;
+    double myFrameStart;
+    long myFrameAllocations;
+    bool myShowHUD;
+
+    void clearCurrent ()
+    {
+        for (int k = 0; k < NUM_FRAME_PHASES; k++)
+        {
+            myCurrent.phase[k] = 0;
+            myPhaseStart[k] = 0;
+            myCurrent.allocations[k] = 0;
+            myPhaseAllocations[k] = 0;
+        }
+        myCurrent.total = 0;
+        for (int k = 0; k < NUM_FRAME_COUNTERS; k++)
+        {
+            myCurrent.counters[k] = 0;
+        }
+    }
+
+    /*
+     * Returns the p-th percentile (0..1) of the count samples given, which are reordered.
+     */
+    static double percentile (double * samples, int count, double p)
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        int rank = int(p * (count - 1) + 0.5);
+        nth_element(samples, samples + rank, samples + count);
+        return samples[rank];
+    }
+
+  public:
+    static const char * PHASE_NAMES[NUM_FRAME_PHASES];
+    static const char * COUNTER_NAMES[NUM_FRAME_COUNTERS];
+    static const double PERCENTILES[NUM_PERCENTILES];
+
+
+    FrameProfiler ()
+      : myWindowHead(0),
+        myWindowCount(0),
+        myNumFrames(0),
+        myFrameStart(now()),
+        myFrameAllocations(countAllocations()),
+        myShowHUD(false)
+    {
+        clearCurrent();
+        for (int k = 0; k <= NUM_FRAME_PHASES; k++)
+        {
+            for (int p = 0; p < NUM_PERCENTILES; p++)
+            {
+                mySummary[k][p] = 0;
+            }
+        }
+        myHistory.reserve(HISTORY_SIZE);
+    }
+
+
+    /*
+     * Returns the current time in milliseconds from a monotonic clock.
+     */
+    static double now ()
+    {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+    }
+
+
+    /*
+     * Marks the start of the given phase in the current frame.
+     */
+    void begin (FramePhase phase)
+    {
+        myPhaseStart[phase] = now();
+        myPhaseAllocations[phase] = countAllocations();
+    }
+
+
+    /*
+     * Marks the end of the given phase; a phase may run several times
+     * per frame, in which case its durations are summed.
+     */
+    void end (FramePhase phase)
+    {
+        myCurrent.phase[phase] += now() - myPhaseStart[phase];
+        myCurrent.allocations[phase] += countAllocations() - myPhaseAllocations[phase];
+    }
+
+
+    /*
+     * Adds amount to the given counter of the current frame.
+     */
+    void count (FrameCounter counter, long amount)
+    {
+        myCurrent.counters[counter] += amount;
+    }
+
+
+    /*
+     * Commits the current frame to the rolling window and history.
+     */
+    void endFrame ()
+    {
+        double frameEnd = now();
+        myCurrent.total = frameEnd - myFrameStart;
+        myFrameStart = frameEnd;
+        myCurrent.counters[COUNTER_ALLOCATIONS] = countAllocations() - myFrameAllocations;
+
+        myWindow[myWindowHead] = myCurrent;
+        myWindowHead = (myWindowHead + 1) % WINDOW_SIZE;
+        if (myWindowCount < WINDOW_SIZE)
+        {
+            myWindowCount++;
+        }
+        if (myHistory.size() < size_t(HISTORY_SIZE))
+        {
+            myHistory.push_back(myCurrent);
+        }
+        else
+        {
+            myHistory[myNumFrames % HISTORY_SIZE] = myCurrent;
+        }
+        myNumFrames++;
+        clearCurrent();
+        myFrameAllocations = countAllocations();
+    }
+
+
+    /*
+     * Recomputes the cached percentiles from the rolling window.
+     *
+     * Sorting is kept out of endFrame() so it can be done at a
+     * slower rate (e.g., once a second when the title is updated).
+     */
+    void updateSummary ()
+    {
+        for (int k = 0; k <= NUM_FRAME_PHASES; k++)
+        {
+            for (int s = 0; s < myWindowCount; s++)
+            {
+                mySamples[s] = (k < NUM_FRAME_PHASES) ? myWindow[s].phase[k]
+                                                      : myWindow[s].total;
+            }
+            for (int p = 0; p < NUM_PERCENTILES; p++)
+            {
+                mySummary[k][p] = percentile(mySamples, myWindowCount, PERCENTILES[p]);
+            }
+        }
+    }
+
+
+    /*
+     * Returns cached percentile index p (0 = p50, 1 = p95, 2 = p99) for
+     * the given phase, or for the whole frame if phase is NUM_FRAME_PHASES.
+     */
+    double getSummary (int phase, int p) const
+    {
+        return mySummary[phase][p];
+    }
+
+
+    /*
+     * Returns how many frames have been committed, including those the
+     * history no longer holds.
+     */
+    long getFrameCount () const
+    {
+        return myNumFrames;
+    }
+
+
+    /*
+     * Returns the allocations the profiling thread made in the given
+     * phase of the last frame committed.
+     */
+    long getLastAllocations (int phase) const
+    {
+        return (myNumFrames == 0) ? 0 : getLast().allocations[phase];
+    }
+
+
+    /*
+     * Returns the given counter of the last frame committed.
+     */
+    long getLastCount (int counter) const
+    {
+        return (myNumFrames == 0) ? 0 : getLast().counters[counter];
+    }
+
+
+    /*
+     * Adds the frame history to report, under "profiler".
+     */
+    void reportMemory (MemoryReport& report) const
+    {
+        report.add("profiler", MemoryReport::bytesOf(myHistory), long(myHistory.size()));
+    }
+
+
+    bool isHUDVisible () const
+    {
+        return myShowHUD;
+    }
+
+
+    void toggleHUD ()
+    {
+        myShowHUD = ! myShowHUD;
+    }
+
+
+    /*
+     * Draws the cached percentiles as text over the top left corner of
+     * a viewport of the given size.
+     */
+    void drawHUD (int width, int height)
+    {
+#ifndef DEF_USE_CGLX
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        gluOrtho2D(0, width, 0, height);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+
+        glColor3d(1, 1, 0);
+        char line[128];
+        const int LINE_HEIGHT = 15;
+        int y = height - LINE_HEIGHT;
+        snprintf(line, sizeof(line), "%-9s %7s %7s %7s (ms)", "phase", "p50", "p95", "p99");
+        drawText(10, y, line);
+        for (int k = 0; k <= NUM_FRAME_PHASES; k++)
+        {
+            y -= LINE_HEIGHT;
+            snprintf(line, sizeof(line), "%-9s %7.2f %7.2f %7.2f",
+                     (k < NUM_FRAME_PHASES) ? PHASE_NAMES[k] : "frame",
+                     mySummary[k][0], mySummary[k][1], mySummary[k][2]);
+            drawText(10, y, line);
+        }
+        for (int k = 0; k < NUM_FRAME_COUNTERS; k++)
+        {
+            y -= LINE_HEIGHT;
+            snprintf(line, sizeof(line), "%-13s %7ld", COUNTER_NAMES[k], getLastCount(k));
+            drawText(10, y, line);
+        }
+
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+#endif
+    }
+
+
+    /*
+     * Writes one row per frame the history holds, oldest first and
+     * numbered from the first frame ever committed, to the given file.
+     *
+     * Returns false if the file could not be written.
+     */
+    bool writeCSV (const char * fileName) const
+    {
+        FILE * out = fopen(fileName, "w");
+        if (out == NULL)
+        {
+            return false;
+        }
+        fprintf(out, "frame");
+        for (int k = 0; k < NUM_FRAME_PHASES; k++)
+        {
+            fprintf(out, ",%s_ms", PHASE_NAMES[k]);
+        }
+        fprintf(out, ",frame_ms");
+        for (int k = 0; k < NUM_FRAME_COUNTERS; k++)
+        {
+            fprintf(out, ",%s", COUNTER_NAMES[k]);
+        }
+        for (int k = 0; k < NUM_FRAME_PHASES; k++)
+        {
+            fprintf(out, ",%s_allocations", PHASE_NAMES[k]);
+        }
+        fprintf(out, "\n");
+        for (long f = myNumFrames - long(myHistory.size()); f < myNumFrames; f++)
+        {
+            const FrameSample& sample = myHistory[f % HISTORY_SIZE];
+            fprintf(out, "%ld", f);
+            for (int k = 0; k < NUM_FRAME_PHASES; k++)
+            {
+                fprintf(out, ",%.4f", sample.phase[k]);
+            }
+            fprintf(out, ",%.4f", sample.total);
+            for (int k = 0; k < NUM_FRAME_COUNTERS; k++)
+            {
+                fprintf(out, ",%ld", sample.counters[k]);
+            }
+            for (int k = 0; k < NUM_FRAME_PHASES; k++)
+            {
+                fprintf(out, ",%ld", sample.allocations[k]);
+            }
+            fprintf(out, "\n");
+        }
+        return fclose(out) == 0;
+    }
+
+
+    /*
+     * Prints the percentiles of the current window.
+     */
+    void printSummary (ostream& out)
+    {
+        updateSummary();
+        char line[128];
+        snprintf(line, sizeof(line), "%-9s %7s %7s %7s (ms, last %d frames)",
+                 "phase", "p50", "p95", "p99", myWindowCount);
+        out << line << endl;
+        for (int k = 0; k <= NUM_FRAME_PHASES; k++)
+        {
+            snprintf(line, sizeof(line), "%-9s %7.3f %7.3f %7.3f",
+                     (k < NUM_FRAME_PHASES) ? PHASE_NAMES[k] : "frame",
+                     mySummary[k][0], mySummary[k][1], mySummary[k][2]);
+            out << line << endl;
+        }
+        for (int k = 0; k < NUM_FRAME_COUNTERS; k++)
+        {
+            snprintf(line, sizeof(line), "%-13s %7ld (last frame)", COUNTER_NAMES[k], getLastCount(k));
+            out << line << endl;
+        }
+    }
+
+  private:
+    const FrameSample& getLast () const
+    {
+        return myHistory[(myNumFrames - 1) % HISTORY_SIZE];
+    }
+
+
+    static void drawText (int x, int y, const char * text)
+    {
+#ifndef DEF_USE_CGLX
+        glRasterPos2i(x, y);
+        for (const char * c = text; *c != '\0'; c++)
+        {
+            glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+        }
+#endif
+    }
+};
+
+const char * FrameProfiler::PHASE_NAMES[NUM_FRAME_PHASES] =
+{
+    "simulate", "camera", "cull", "draw", "swap"
+};
+const char * FrameProfiler::COUNTER_NAMES[NUM_FRAME_COUNTERS] =
+{
+    "draw_calls", "state_changes", "impostors", "occluded", "allocations"
+};
+const double FrameProfiler::PERCENTILES[NUM_PERCENTILES] = { 0.50, 0.95, 0.99 };
+
+#endif
@@ -0,0 +1,122 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines the view frustum of a whole wall or one of its
+// tiles.  Where the driver allows it, the frustum has no far plane
+// and depth is reversed: the near plane maps to depth 1 and infinity
+// to 0, with depth from 0 to 1 rather than -1 to 1 (glClipControl),
+// so a float depth buffer keeps about the same relative precision at
+// every distance and huge catalogs need no far plane at all.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef FRUSTUM_H_
+#define FRUSTUM_H_
+
+#include <math.h>
+#include <cstring>           // for strstr
+#include <cstdio>            // for sscanf
+#include "cglx.h"
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+/*
+ * The near plane rectangle and depth range passed to glFrustum.
+ */
+struct Frustum
+{
+    double left, right, bottom, top, nearDistance, farDistance;
+    // reversed depth with no far plane (see enableReversedDepth())
+    bool isReversed;
+
+
+    /*
+     * Returns the frustum gluPerspective would use.
+     */
+    static Frustum perspective (double fovY, double aspect, double nearDistance, double farDistance)
+    {
+        Frustum f;
+        f.top = nearDistance * tan(fovY * M_PI / 360.0);
+        f.bottom = -f.top;
+        f.right = f.top * aspect;
+        f.left = -f.right;
+        f.nearDistance = nearDistance;
+        f.farDistance = farDistance;
+        f.isReversed = false;
+        return f;
+    }
+
+
+    /*
+     * Sets the current context up for reversed depth: depth from 0 to
+     * 1, cleared to 0 (infinitely far), where greater is nearer.
+     *
+     * Returns false, changing nothing, if the driver cannot.
+     */
+    static bool enableReversedDepth ()
+    {
+#ifdef GL_ZERO_TO_ONE
+        const char * version = (const char *)glGetString(GL_VERSION);
+        const char * extensions = (const char *)glGetString(GL_EXTENSIONS);
+        int major = 0, minor = 0;
+        if (version != NULL)
+        {
+            sscanf(version, "%d.%d", &major, &minor);
+        }
+        if (major * 10 + minor < 45 &&
+            (extensions == NULL || strstr(extensions, "GL_ARB_clip_control") == NULL))
+        {
+            return false;
+        }
+        glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glClearDepth(0);
+        glDepthFunc(GL_GREATER);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    /*
+     * Returns the off-axis part of this frustum seen by tile (col, row)
+     * of a cols x rows grid, where row 0 is the bottom row.
+     */
+    Frustum tile (int col, int row, int cols, int rows) const
+    {
+        Frustum f = *this;
+        double width = (right - left) / cols;
+        double height = (top - bottom) / rows;
+        f.left = left + col * width;
+        f.right = f.left + width;
+        f.bottom = bottom + row * height;
+        f.top = f.bottom + height;
+        return f;
+    }
+
+
+    /*
+     * Multiplies the current matrix by this frustum.
+     */
+    void apply () const
+    {
+        if (! isReversed)
+        {
+            glFrustum(left, right, bottom, top, nearDistance, farDistance);
+            return;
+        }
+        // glFrustum with the far plane at infinity and depth = near / -z
+        GLdouble m[16] = { 0 };
+        m[0] = 2 * nearDistance / (right - left);
+        m[5] = 2 * nearDistance / (top - bottom);
+        m[8] = (right + left) / (right - left);
+        m[9] = (top + bottom) / (top - bottom);
+        m[11] = -1;
+        m[14] = nearDistance;
+        glMultMatrixd(m);
+    }
+};
+
+#endif
@@ -0,0 +1,248 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines wireframe shapes drawn from cached vertex
+// arrays.  They match what glutWireSphere and glutWireTorus draw,
+// but do not rebuild the mesh on every call and do not need GLUT
+// to be initialized, so they also work in an offscreen context.
+// It also defines a quad that shows an image over the viewport.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef GEOMETRY_H_
+#define GEOMETRY_H_
+
+#include <math.h>
+#include <vector>
+#include "cglx.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class WireMesh
+{
+  private:
+    // line segments as pairs of xyz vertices
+    vector<GLfloat> myVertices;
+
+    void addVertex (double x, double y, double z)
+    {
+        myVertices.push_back(GLfloat(x));
+        myVertices.push_back(GLfloat(y));
+        myVertices.push_back(GLfloat(z));
+    }
+
+  public:
+    /*
+     * Builds a unit sphere the way glutWireSphere does: stacks - 1
+     * circles of latitude plus slices lines of longitude, with the
+     * poles on the z axis.
+     */
+    void buildSphere (int slices, int stacks)
+    {
+        myVertices.clear();
+        for (int j = 1; j < stacks; j++)
+        {
+            double theta = M_PI * j / stacks;
+            double r = sin(theta), z = cos(theta);
+            for (int i = 0; i < slices; i++)
+            {
+                double phi0 = 2 * M_PI * i / slices;
+                double phi1 = 2 * M_PI * (i + 1) / slices;
+                addVertex(r * cos(phi0), r * sin(phi0), z);
+                addVertex(r * cos(phi1), r * sin(phi1), z);
+            }
+        }
+        for (int i = 0; i < slices; i++)
+        {
+            double phi = 2 * M_PI * i / slices;
+            for (int j = 0; j < stacks; j++)
+            {
+                double theta0 = M_PI * j / stacks;
+                double theta1 = M_PI * (j + 1) / stacks;
+                addVertex(sin(theta0) * cos(phi), sin(theta0) * sin(phi), cos(theta0));
+                addVertex(sin(theta1) * cos(phi), sin(theta1) * sin(phi), cos(theta1));
+            }
+        }
+    }
+
+
+    /*
+     * Builds a torus the way glutWireTorus does: a loop around the
+     * tube at each of rings positions plus a loop along the tube at
+     * each of sides positions.
+     */
+    void buildTorus (double innerRadius, double outerRadius, int sides, int rings)
+    {
+        myVertices.clear();
+        for (int j = 0; j < rings; j++)
+        {
+            double psi = 2 * M_PI * j / rings;
+            for (int i = 0; i < sides; i++)
+            {
+                double phi0 = 2 * M_PI * i / sides;
+                double phi1 = 2 * M_PI * (i + 1) / sides;
+                addVertex(cos(psi) * (outerRadius + cos(phi0) * innerRadius),
+                          sin(psi) * (outerRadius + cos(phi0) * innerRadius),
+                          sin(phi0) * innerRadius);
+                addVertex(cos(psi) * (outerRadius + cos(phi1) * innerRadius),
+                          sin(psi) * (outerRadius + cos(phi1) * innerRadius),
+                          sin(phi1) * innerRadius);
+            }
+        }
+        if (rings > 1)
+        {
+            for (int i = 0; i < sides; i++)
+            {
+                double phi = 2 * M_PI * i / sides;
+                for (int j = 0; j < rings; j++)
+                {
+                    double psi0 = 2 * M_PI * j / rings;
+                    double psi1 = 2 * M_PI * (j + 1) / rings;
+                    addVertex(cos(psi0) * (outerRadius + cos(phi) * innerRadius),
+                              sin(psi0) * (outerRadius + cos(phi) * innerRadius),
+                              sin(phi) * innerRadius);
+                    addVertex(cos(psi1) * (outerRadius + cos(phi) * innerRadius),
+                              sin(psi1) * (outerRadius + cos(phi) * innerRadius),
+                              sin(phi) * innerRadius);
+                }
+            }
+        }
+    }
+
+
+    int getVertexCount () const
+    {
+        return int(myVertices.size() / 3);
+    }
+
+
+    size_t getBytes () const
+    {
+        return myVertices.capacity() * sizeof(GLfloat);
+    }
+
+
+    const GLfloat * getVertices () const
+    {
+        return myVertices.empty() ? NULL : &myVertices[0];
+    }
+
+
+    /*
+     * Draws the mesh with the current color and matrix.
+     */
+    void draw () const
+    {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, getVertices());
+        glDrawArrays(GL_LINES, 0, getVertexCount());
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+};
+
+
+/*
+ * Draws a wireframe sphere, caching the mesh of the most recently
+ * used resolution (per thread, so several contexts can draw at once).
+ */
+inline void wireSphere (double radius, int slices, int stacks)
+{
+    static thread_local WireMesh theMesh;
+    static thread_local int theSlices = 0, theStacks = 0;
+    if (slices != theSlices || stacks != theStacks)
+    {
+        theMesh.buildSphere(slices, stacks);
+        theSlices = slices;
+        theStacks = stacks;
+    }
+    glPushMatrix();
+    glScaled(radius, radius, radius);
+    theMesh.draw();
+    glPopMatrix();
+}
+
+
+/*
+ * Draws a wireframe torus, caching the mesh of the most recently
+ * used dimensions (per thread).
+ */
+inline void wireTorus (double innerRadius, double outerRadius, int sides, int rings)
+{
+    static thread_local WireMesh theMesh;
+    static thread_local double theRatio = -1;
+    static thread_local int theSides = 0, theRings = 0;
+    // the torus only changes shape with the ratio of its radii
+    double ratio = (outerRadius != 0) ? innerRadius / outerRadius : 0;
+    if (ratio != theRatio || sides != theSides || rings != theRings)
+    {
+        theMesh.buildTorus(ratio, 1, sides, rings);
+        theRatio = ratio;
+        theSides = sides;
+        theRings = rings;
+    }
+    glPushMatrix();
+    glScaled(outerRadius, outerRadius, outerRadius);
+    theMesh.draw();
+    glPopMatrix();
+}
+
+/*
+ * Draws an RGBA image (rows bottom first) stretched over the whole
+ * viewport, e.g., to show a frame rendered somewhere else.
+ */
+class ImageQuad
+{
+  private:
+    GLuint myTexture;
+
+  public:
+    ImageQuad ()
+      : myTexture(0)
+    {
+    }
+
+
+    void draw (int width, int height, const unsigned char * pixels)
+    {
+        if (myTexture == 0)
+        {
+            glGenTextures(1, &myTexture);
+            glBindTexture(GL_TEXTURE_2D, myTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glBindTexture(GL_TEXTURE_2D, myTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_TEXTURE_2D);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        gluOrtho2D(0, 1, 0, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        glColor3d(1, 1, 1);
+        glBegin(GL_QUADS);
+          glTexCoord2d(0, 0); glVertex2d(0, 0);
+          glTexCoord2d(1, 0); glVertex2d(1, 0);
+          glTexCoord2d(1, 1); glVertex2d(1, 1);
+          glTexCoord2d(0, 1); glVertex2d(0, 1);
+        glEnd();
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+    }
+};
+
+#endif
@@ -0,0 +1,494 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a pool of threads that encode and write frames
+// to disk, so the thread rendering them only has to copy pixels
+// into a free buffer and move on.
+//
+// Buffers are allocated once and recycled; the renderer only waits
+// if every buffer is still queued, i.e., if the disk cannot keep
+// up on average.  Images are written as PNG (compressed with zlib)
+// or PPM, or appended to Y4M or raw video streams, chosen by the
+// file name's extension.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef IMAGE_WRITER_H_
+#define IMAGE_WRITER_H_
+
+#include <stdint.h>
+#include <time.h>            // clock_gettime
+#include <cstdio>            // for fopen
+#include <cstring>           // for strlen
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>         // for min, max
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+#include "memory_report.h"
+#include "trace.h"
+
+using namespace std;
+
+/*
+ * One frame to write: RGBA rows, bottom row first, as glReadPixels
+ * returns them.
+ */
+struct ImageFrame
+{
+    vector<unsigned char> pixels;
+    int width, height;
+    string fileName;
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class ImageWriter
+{
+  private:
+    vector<thread> myWorkers;
+    mutex myLock;
+    condition_variable myQueued;
+    condition_variable myFreed;
+    deque<ImageFrame *> myQueue;
+    vector<ImageFrame *> myFree;
+    vector<ImageFrame *> myFrames;
+    bool isStopping;
+    int myNumWritten;
+    int myNumFailed;
+    // time the renderer spent waiting for a free buffer
+    double myWaitMs;
+    // stream (.y4m or .rgba) frames are being appended to
+    FILE * myStream;
+    string myStreamName;
+    int myFrameRate;
+
+    void closeStream ()
+    {
+        if (myStream != NULL)
+        {
+            fclose(myStream);
+            myStream = NULL;
+            myStreamName.clear();
+        }
+    }
+
+    /*
+     * Appends a frame to the stream named by its file name, starting
+     * a new stream if it is not the current one.
+     */
+    bool writeStream (const ImageFrame& frame, vector<unsigned char>& scratch)
+    {
+        bool isY4M = hasExtension(frame.fileName, ".y4m");
+        // 4:2:0 chroma needs even sizes, so odd edges are cropped
+        int width = isY4M ? (frame.width & ~1) : frame.width;
+        int height = isY4M ? (frame.height & ~1) : frame.height;
+        if (frame.fileName != myStreamName)
+        {
+            closeStream();
+            myStream = fopen(frame.fileName.c_str(), "wb");
+            if (myStream == NULL)
+            {
+                return false;
+            }
+            myStreamName = frame.fileName;
+            if (isY4M)
+            {
+                fprintf(myStream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                        width, height, myFrameRate);
+            }
+        }
+        if (! isY4M)
+        {
+            for (int y = height - 1; y >= 0; y--)
+            {
+                fwrite(&frame.pixels[size_t(y) * frame.width * 4], 1, size_t(width) * 4, myStream);
+            }
+            return ferror(myStream) == 0;
+        }
+
+        // full range BT.601, as JPEG uses; chroma averaged over 2x2 pixels
+        size_t lumaSize = size_t(width) * height;
+        scratch.resize(lumaSize + lumaSize / 2);
+        unsigned char * luma = &scratch[0];
+        unsigned char * blue = luma + lumaSize;
+        unsigned char * red = blue + lumaSize / 4;
+        for (int y = 0; y < height; y += 2)
+        {
+            for (int x = 0; x < width; x += 2)
+            {
+                int sumB = 0, sumR = 0;
+                for (int k = 0; k < 4; k++)
+                {
+                    int px = x + (k & 1), py = y + (k >> 1);
+                    const unsigned char * p =
+                        &frame.pixels[(size_t(frame.height - 1 - py) * frame.width + px) * 4];
+                    int l = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+                    luma[size_t(py) * width + px] = (unsigned char)l;
+                    sumB += p[2] - l;
+                    sumR += p[0] - l;
+                }
+                // Cb = 0.564 (B - Y), Cr = 0.713 (R - Y), over 4 pixels
+                size_t c = size_t(y / 2) * (width / 2) + x / 2;
+                blue[c] = (unsigned char)max(0, min(255, 128 + (sumB * 36 + 128) / 256));
+                red[c] = (unsigned char)max(0, min(255, 128 + (sumR * 46 + 128) / 256));
+            }
+        }
+        fputs("FRAME\n", myStream);
+        fwrite(&scratch[0], 1, scratch.size(), myStream);
+        return ferror(myStream) == 0;
+    }
+
+    void writeFrames ()
+    {
+        vector<unsigned char> scratch;
+        while (true)
+        {
+            ImageFrame * frame;
+            {
+                unique_lock<mutex> guard(myLock);
+                while (myQueue.empty() && ! isStopping)
+                {
+                    myQueued.wait(guard);
+                }
+                if (myQueue.empty())
+                {
+                    return;
+                }
+                frame = myQueue.front();
+                myQueue.pop_front();
+            }
+            bool ok = write(*frame, scratch);
+            {
+                lock_guard<mutex> guard(myLock);
+                (ok ? myNumWritten : myNumFailed)++;
+                myFree.push_back(frame);
+            }
+            myFreed.notify_all();
+        }
+    }
+
+    static void putBigEndian (vector<unsigned char>& out, uint32_t value)
+    {
+        out.push_back(value >> 24);
+        out.push_back(value >> 16);
+        out.push_back(value >> 8);
+        out.push_back(value);
+    }
+
+    static void putChunk (FILE * out, const char * type, const unsigned char * data, size_t length)
+    {
+        vector<unsigned char> header;
+        putBigEndian(header, uint32_t(length));
+        header.insert(header.end(), type, type + 4);
+        uLong crc = crc32(0, (const Bytef *)type, 4);
+        if (length > 0)
+        {
+            crc = crc32(crc, data, uInt(length));
+        }
+        vector<unsigned char> footer;
+        putBigEndian(footer, uint32_t(crc));
+        fwrite(&header[0], 1, header.size(), out);
+        fwrite(data, 1, length, out);
+        fwrite(&footer[0], 1, footer.size(), out);
+    }
+
+  public:
+    // zlib level for PNG: fast, since disk bandwidth is rarely the limit
+    static const int PNG_COMPRESSION = 1;
+
+
+    ImageWriter ()
+      : isStopping(false),
+        myNumWritten(0),
+        myNumFailed(0),
+        myWaitMs(0),
+        myStream(NULL),
+        myFrameRate(25)
+    {
+    }
+
+
+    ~ImageWriter ()
+    {
+        finish();
+        for (size_t k = 0; k < myFrames.size(); k++)
+        {
+            delete myFrames[k];
+        }
+    }
+
+
+    /*
+     * Starts numThreads writers sharing numBuffers frame buffers.
+     */
+    void start (int numThreads, int numBuffers)
+    {
+        finish();
+        isStopping = false;
+        for (int k = int(myFrames.size()); k < numBuffers; k++)
+        {
+            myFrames.push_back(new ImageFrame());
+            myFree.push_back(myFrames.back());
+        }
+        for (int k = 0; k < numThreads; k++)
+        {
+            myWorkers.push_back(thread(&ImageWriter::writeFrames, this));
+        }
+    }
+
+
+    /*
+     * Returns a free buffer sized for a width x height frame, waiting
+     * for one if all are queued.
+     */
+    ImageFrame * acquire (int width, int height)
+    {
+        ImageFrame * frame;
+        {
+            unique_lock<mutex> guard(myLock);
+            if (myFree.empty())
+            {
+                TRACE_SCOPE("ImageWriter::wait");
+                timespec start, end;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                while (myFree.empty())
+                {
+                    myFreed.wait(guard);
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                myWaitMs += (end.tv_sec - start.tv_sec) * 1000.0 +
+                            (end.tv_nsec - start.tv_nsec) / 1000000.0;
+            }
+            frame = myFree.back();
+            myFree.pop_back();
+        }
+        frame->width = width;
+        frame->height = height;
+        frame->pixels.resize(size_t(width) * height * 4);
+        return frame;
+    }
+
+
+    /*
+     * Returns a free buffer as acquire() does, or NULL instead of
+     * waiting if none is free.
+     */
+    ImageFrame * tryAcquire (int width, int height)
+    {
+        ImageFrame * frame;
+        {
+            lock_guard<mutex> guard(myLock);
+            if (myFree.empty())
+            {
+                return NULL;
+            }
+            frame = myFree.back();
+            myFree.pop_back();
+        }
+        frame->width = width;
+        frame->height = height;
+        frame->pixels.resize(size_t(width) * height * 4);
+        return frame;
+    }
+
+
+    /*
+     * Queues a frame from acquire() to be written to fileName.
+     */
+    void submit (ImageFrame * frame, const char * fileName)
+    {
+        // reuses the buffer's string, so steady-state frames do not allocate
+        frame->fileName.assign(fileName);
+        {
+            lock_guard<mutex> guard(myLock);
+            myQueue.push_back(frame);
+        }
+        myQueued.notify_one();
+    }
+
+
+    /*
+     * Writes everything queued, then stops the writer threads.
+     */
+    void finish ()
+    {
+        {
+            lock_guard<mutex> guard(myLock);
+            isStopping = true;
+        }
+        myQueued.notify_all();
+        for (size_t k = 0; k < myWorkers.size(); k++)
+        {
+            myWorkers[k].join();
+        }
+        myWorkers.clear();
+        closeStream();
+    }
+
+
+    /*
+     * Adds the frame buffers and their file names to report, under
+     * "recorders".
+     */
+    void reportMemory (MemoryReport& report)
+    {
+        lock_guard<mutex> guard(myLock);
+        size_t bytes = MemoryReport::bytesOf(myFrames) + MemoryReport::bytesOf(myFree) +
+                       MemoryReport::bytesOf(myStreamName);
+        for (size_t k = 0; k < myFrames.size(); k++)
+        {
+            bytes += sizeof(ImageFrame) + MemoryReport::bytesOf(myFrames[k]->pixels) +
+                     MemoryReport::bytesOf(myFrames[k]->fileName);
+        }
+        report.add("recorders", bytes, long(myFrames.size()));
+    }
+
+
+    int getNumWritten ()
+    {
+        lock_guard<mutex> guard(myLock);
+        return myNumWritten;
+    }
+
+
+    int getNumFailed ()
+    {
+        lock_guard<mutex> guard(myLock);
+        return myNumFailed;
+    }
+
+
+    double getWaitMs ()
+    {
+        lock_guard<mutex> guard(myLock);
+        return myWaitMs;
+    }
+
+
+    /*
+     * Writes one frame according to its file name's extension:
+     *   .ppm   binary PPM
+     *   .y4m   appended to a YUV4MPEG2 (4:2:0) stream
+     *   .rgba  appended to a raw stream of RGBA frames, top row first
+     *   other  PNG
+     * Streams stay open until a frame for another file arrives or the
+     * writer finishes, so they need a single writer thread.
+     *
+     * Returns false if the file could not be written.
+     */
+    bool write (const ImageFrame& frame, vector<unsigned char>& scratch)
+    {
+        TRACE_SCOPE("ImageWriter::write");
+        if (hasExtension(frame.fileName, ".y4m") || hasExtension(frame.fileName, ".rgba"))
+        {
+            return writeStream(frame, scratch);
+        }
+        if (hasExtension(frame.fileName, ".ppm"))
+        {
+            return writePPM(frame, scratch);
+        }
+        return writePNG(frame, scratch);
+    }
+
+
+    static bool hasExtension (const string& name, const char * extension)
+    {
+        size_t length = strlen(extension);
+        return name.size() >= length && name.compare(name.size() - length, length, extension) == 0;
+    }
+
+
+    /*
+     * Sets the frames per second recorded in .y4m streams.
+     */
+    void setFrameRate (int framesPerSecond)
+    {
+        myFrameRate = framesPerSecond;
+    }
+
+
+    /*
+     * Writes a binary PPM (P6).
+     */
+    static bool writePPM (const ImageFrame& frame, vector<unsigned char>& scratch)
+    {
+        FILE * out = fopen(frame.fileName.c_str(), "wb");
+        if (out == NULL)
+        {
+            return false;
+        }
+        fprintf(out, "P6\n%d %d\n255\n", frame.width, frame.height);
+        scratch.resize(size_t(frame.width) * 3);
+        for (int y = frame.height - 1; y >= 0; y--)
+        {
+            const unsigned char * row = &frame.pixels[size_t(y) * frame.width * 4];
+            for (int x = 0; x < frame.width; x++)
+            {
+                scratch[3 * x] = row[4 * x];
+                scratch[3 * x + 1] = row[4 * x + 1];
+                scratch[3 * x + 2] = row[4 * x + 2];
+            }
+            fwrite(&scratch[0], 1, scratch.size(), out);
+        }
+        return fclose(out) == 0;
+    }
+
+
+    /*
+     * Writes an 8-bit RGB PNG.
+     */
+    static bool writePNG (const ImageFrame& frame, vector<unsigned char>& scratch)
+    {
+        // each row is a filter byte (none) then RGB, top row first;
+        // the rows and their compressed form share the scratch buffer
+        size_t rowSize = 1 + size_t(frame.width) * 3;
+        size_t rawSize = rowSize * frame.height;
+        uLongf length = compressBound(rawSize);
+        scratch.resize(rawSize + length);
+        unsigned char * raw = &scratch[0];
+        unsigned char * compressed = &scratch[rawSize];
+        for (int y = 0; y < frame.height; y++)
+        {
+            const unsigned char * row = &frame.pixels[size_t(frame.height - 1 - y) * frame.width * 4];
+            unsigned char * to = &raw[y * rowSize];
+            *to++ = 0;
+            for (int x = 0; x < frame.width; x++)
+            {
+                *to++ = row[4 * x];
+                *to++ = row[4 * x + 1];
+                *to++ = row[4 * x + 2];
+            }
+        }
+        if (compress2(compressed, &length, raw, rawSize, PNG_COMPRESSION) != Z_OK)
+        {
+            return false;
+        }
+
+        FILE * out = fopen(frame.fileName.c_str(), "wb");
+        if (out == NULL)
+        {
+            return false;
+        }
+        static const unsigned char SIGNATURE[] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+        fwrite(SIGNATURE, 1, sizeof(SIGNATURE), out);
+        vector<unsigned char> header;
+        putBigEndian(header, frame.width);
+        putBigEndian(header, frame.height);
+        // 8 bits per channel, RGB, deflate, no filtering, not interlaced
+        const unsigned char FORMAT[] = { 8, 2, 0, 0, 0 };
+        header.insert(header.end(), FORMAT, FORMAT + 5);
+        putChunk(out, "IHDR", &header[0], header.size());
+        putChunk(out, "IDAT", compressed, length);
+        putChunk(out, "IEND", NULL, 0);
+        return fclose(out) == 0;
+    }
+};
+
+#endif
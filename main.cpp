@@ -12,7 +12,7 @@
 //////////////////////////////////////////////////////////////////
 // Includes
 //
-#include <cstdio>            // for sprintf
+#include <cstdio>            // for sprintf, sscanf
 #include <cstring>           // for strlen
 #include <cstdlib>           // for exit
 #include <sys/time.h>        // gettimeofday
@@ -20,6 +20,16 @@
 #include "cglx.h"            // for CGLX or GLUT
 using namespace std;
 #include "scene.h"
+#include "frame_profiler.h"
+#include "trace.h"
+#include "tiled_renderer.h"
+#include "cluster.h"
+#include "state_feed.h"
+#include "offscreen.h"
+#include "image_writer.h"
+#include "frame_capture.h"
+#include "splat_renderer.h"
+#include "memory_report.h"
 
 
 //////////////////////////////////////////////////////////////////
@@ -34,13 +44,48 @@ bool         isAnimating = true;
 bool         isFullScreen = false;
 unsigned int currentTime;
 Scene *      theScene = new Scene();
+FrameProfiler theProfiler;
+// renders a monitor wall as tiles on this host (see -wall)
+TiledRenderer theTiles(theScene);
+int          theWallCols = 0, theWallRows = 0;
+int          theTileWidth = 960, theTileHeight = 540;
+// shares the simulation with render nodes (see -master and -node)
+ClusterMaster * theMaster = NULL;
+ClusterNode * theNode = NULL;
+// publishes each tick to shared memory (see -feed)
+StateFeed    theFeed;
+string       theFeedName;
+// renders frames to files without a window (see -headless)
+int          theNumHeadlessFrames = 0;
+int          theImageWidth = 1920, theImageHeight = 1080;
+string       theOutputPattern = "frame_%05d.png";
+int          theNumWriters = 2;
+// saves screenshots and recordings from the window (see 'g' and 'v')
+FrameCapture theCapture;
+string       theScreenshotPattern = "screenshot_%03d.png";
+string       theRecordPattern = "capture_%02d.y4m";
+// draws bodies as splats on the CPU instead (see 'x' and -splat)
+SplatRenderer * theSplats = NULL;
+bool         isSplatting = false;
+// shows trails from the start (see -trails)
+bool         isShowingTrails = false;
+// no far plane, with depth reversed for precision (see frustum.h)
+bool         isReversedDepth = false;
+// how body angle sines and cosines are found (see -trig)
+SinCosAccuracy theSinCosAccuracy = SINCOS_PRECISE;
+// error in pixels that slow or distant bodies may lag by (see -multirate)
+double       theMultiRatePixels = -1;
+// worker threads shared by loading, simulation and culling (see -threads)
+TaskScheduler theScheduler;
 
 // Constants
 //
 const unsigned int ANIMATION_DELAY = 40;    // milliseconds between rendering
 const float        NEAR_DISTANCE = 0.1;     // near plane distance
-const float        FAR_DISTANCE = 500;      // far plane distance
+const float        FAR_DISTANCE = 500;      // far plane distance, unless depth is reversed
 const float        FOV_ANGLE = 45;          // angle of field of view
+const char *       PROFILE_FILE = "frame_profile.csv";  // written on exit
+const char *       TRACE_FILE = "trace.json";           // written on exit, if tracing
 
 
 //////////////////////////////////////////////////////////////////
@@ -63,17 +108,20 @@ unsigned int timeGetTime ()
 void computeFPS ()
 {
     static int frameCount = 0;
-    static int lastFrameTime = 0;
-    static char * title = new char[strlen(theProgramTitle) + 20];
+    static double lastFrameTime = FrameProfiler::now();
+    static char * title = new char[strlen(theProgramTitle) + 40];
 
     frameCount++;
-    int currentFrameTime = timeGetTime();
+    double currentFrameTime = FrameProfiler::now();
     if (currentFrameTime - lastFrameTime > 1000)
     {
-        sprintf(title, "%s [ FPS: %4.2f ]",
+        // refresh percentiles at the same rate as the title
+        theProfiler.updateSummary();
+        sprintf(title, "%s [ FPS: %4.2f, p95: %5.2f ms ]",
                 theProgramTitle,
-                frameCount * 1000.0 / (currentFrameTime - lastFrameTime));
-        lastFrameTime = currentTime;
+                frameCount * 1000.0 / (currentFrameTime - lastFrameTime),
+                theProfiler.getSummary(NUM_FRAME_PHASES, 1));
+        lastFrameTime = currentFrameTime;
         frameCount = 0;
 #ifndef DEF_USE_CGLX
         glutSetWindowTitle(title);
@@ -82,10 +130,69 @@ void computeFPS ()
 }
 
 
+/*
+ * Adds the memory held by the scene and everything around it (but not
+ * the headless writer) to report.
+ */
+void reportMemory (MemoryReport& report)
+{
+    theScene->reportMemory(report);
+    if (theSplats != NULL)
+    {
+        theSplats->reportMemory(report);
+    }
+    theFeed.reportMemory(report);
+    theCapture.reportMemory(report);
+    theProfiler.reportMemory(report);
+}
+
+
+/*
+ * Writes the frame profile when the program exits.
+ */
+void onExit ()
+{
+    theCapture.stop();
+    if (theProfiler.getFrameCount() > 0)
+    {
+        theProfiler.printSummary(cout);
+        if (! theProfiler.writeCSV(PROFILE_FILE))
+        {
+            cerr << "Could not write " << PROFILE_FILE << endl;
+        }
+    }
+    if (theMaster != NULL)
+    {
+        theMaster->report(cout);
+    }
+#ifdef DEF_USE_TRACE
+    if (! Trace::instance().writeChromeJSON(TRACE_FILE))
+    {
+        cerr << "Could not write " << TRACE_FILE << endl;
+    }
+#endif
+}
+
+
+/*
+ * Returns the frustum of the whole view for the given aspect ratio.
+ */
+Frustum getWallFrustum (double aspectRatio)
+{
+    Frustum frustum = Frustum::perspective(FOV_ANGLE, aspectRatio, NEAR_DISTANCE, FAR_DISTANCE);
+    frustum.isReversed = isReversedDepth;
+    return frustum;
+}
+
+
 /*
  * Reset perspective matrix based on size of viewport.
+ *
+ * If tile is given, only that part of a cols x rows grid over the
+ * viewport is seen (i.e., an off-axis frustum for one screen of a wall).
  */
-void setPerspective (GLenum mode, int x = 0, int y = 0)
+void setPerspective (GLenum mode, int x = 0, int y = 0,
+                     int col = 0, int row = 0, int cols = 1, int rows = 1)
 {
     // get info about viewport (x, y, w, h)
     GLint viewport[4];
@@ -105,8 +212,8 @@ void setPerspective (GLenum mode, int x = 0, int y = 0)
     cglx::gluPerspective(FOV_ANGLE, GLdouble(viewport[2]) / GLdouble(viewport[3]), 
                          NEAR_DISTANCE, FAR_DISTANCE);
 #else 
-    gluPerspective(FOV_ANGLE, GLdouble(viewport[2]) / GLdouble(viewport[3]), 
-                   NEAR_DISTANCE, FAR_DISTANCE);
+    getWallFrustum(GLdouble(viewport[2] * cols) / GLdouble(viewport[3] * rows))
+        .tile(col, row, cols, rows).apply();
 #endif
     // prepare to work with model again
     glMatrixMode(GL_MODELVIEW);
@@ -114,11 +221,40 @@ void setPerspective (GLenum mode, int x = 0, int y = 0)
 }
 
 
+/*
+ * Sets the camera and draws the scene as splats into a width x height
+ * image, creating the splat renderer the first time.
+ */
+void renderSplats (int width, int height)
+{
+    if (theSplats == NULL)
+    {
+        theSplats = new SplatRenderer();
+        theSplats->setBodies(theScene->getSolarSystem());
+    }
+    GLdouble modelview[16], projection[16];
+    glPushMatrix();
+      theProfiler.begin(PHASE_CAMERA);
+      theScene->setCamera();
+      // the splats are projected in double, so world coordinates are fine
+      const Point3& eye = theScene->getEye();
+      glTranslated(-eye.x, -eye.y, -eye.z);
+      glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+      glGetDoublev(GL_PROJECTION_MATRIX, projection);
+      theProfiler.end(PHASE_CAMERA);
+    glPopMatrix();
+    theProfiler.begin(PHASE_DRAW);
+    theSplats->render(theScene->getSolarSystem()->getState(), modelview, projection, width, height);
+    theProfiler.end(PHASE_DRAW);
+}
+
+
 /*
  * Determine which objects have been selected by pressing the mouse
  */
 void selectObject (int x, int y)
 {
+    TRACE_SCOPE("selectObject");
     // allocate enough space to store select info
     GLuint selectBuf[512];
     glSelectBuffer(512, selectBuf);
@@ -178,12 +314,57 @@ void onInit (int argc, char * argv[])
     glClearColor(0, 0, 0, 0.0);
     // set to draw in window based on depth 
     glEnable(GL_DEPTH_TEST);
+#ifndef DEF_USE_CGLX
+    isReversedDepth = Frustum::enableReversedDepth();
+#endif
 
     // get info about viewport (x, y, w, h)
     GLint viewport[4];
     glGetIntegerv(GL_VIEWPORT, viewport);
     // init scene with aspect ratio and command-line args
+    theScene->setScheduler(&theScheduler);
     theScene->init((float)viewport[2] / (float)viewport[3], argc, argv);
+    theScene->setSinCosAccuracy(theSinCosAccuracy);
+    if (theMultiRatePixels >= 0)
+    {
+        // the size of a pixel at unit distance, over the whole wall if any
+        double height = (theWallRows > 0) ? double(theWallRows * theTileHeight) : double(viewport[3]);
+        theScene->setMultiRate(0, theMultiRatePixels * 2 * tan(FOV_ANGLE / 2 * M_PI / 180) / height);
+    }
+}
+
+
+/*
+ * Adds the draw calls, state changes, impostors and occluded bodies
+ * of this frame's drawing to the profile.
+ */
+void countDraws ()
+{
+    DrawStats stats = theScene->takeDrawStats();
+    theProfiler.count(COUNTER_DRAW_CALLS, stats.drawCalls);
+    theProfiler.count(COUNTER_STATE_CHANGES, stats.stateChanges);
+    theProfiler.count(COUNTER_IMPOSTORS, stats.impostors);
+    theProfiler.count(COUNTER_OCCLUDED, stats.occluded);
+}
+
+
+/*
+ * Advances the simulation one tick and shares the new state with
+ * render nodes and the state feed.
+ */
+void updateScene ()
+{
+    theProfiler.begin(PHASE_SIMULATE);
+    theScene->update();
+    theProfiler.end(PHASE_SIMULATE);
+    if (theMaster != NULL)
+    {
+        theMaster->broadcast(theScene);
+    }
+    if (theFeed.isOpen())
+    {
+        theFeed.publish(theScene->getSolarSystem()->getState());
+    }
 }
 
 
@@ -195,13 +376,28 @@ void onIdle ()
 {
     static int oldTime = 0;
 
+    // render nodes only draw what the master sends
+    if (theNode != NULL)
+    {
+        if (theNode->receive(theScene, ANIMATION_DELAY))
+        {
+            computeFPS();
+            glutPostRedisplay();
+        }
+        return;
+    }
+    if (theMaster != NULL)
+    {
+        theMaster->acceptNodes();
+    }
+
     if (isAnimating)
     {
         currentTime = timeGetTime();
         if ((currentTime - oldTime) > ANIMATION_DELAY)
         {
             // animate the scene
-            theScene->update();
+            updateScene();
             // compute the frame rate
             oldTime = currentTime;
        	    computeFPS();
@@ -217,27 +413,80 @@ void onIdle ()
  */
 void onDisplay ()
 {
+    TRACE_SCOPE("onDisplay");
     // clears requested bits (color and depth) in glut window
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // draw entire scene into cleared window
-    glPushMatrix();
-      theScene->setCamera();
-      theScene->display();
-    glPopMatrix();
+    // draw wall tiles on their own threads, then show them in the window
+    if (theTiles.isRunning())
+    {
+        theProfiler.begin(PHASE_DRAW);
+        theTiles.renderFrame();
+        theTiles.present();
+        theProfiler.end(PHASE_DRAW);
+    }
+    else if (isSplatting)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        renderSplats(viewport[2], viewport[3]);
+        theSplats->present();
+    }
+    else
+    {
+        // draw entire scene into cleared window
+        glPushMatrix();
+          theProfiler.begin(PHASE_CAMERA);
+          theScene->setCamera();
+          theProfiler.end(PHASE_CAMERA);
+          theProfiler.begin(PHASE_CULL);
+          theScene->cull();
+          theProfiler.end(PHASE_CULL);
+          theProfiler.begin(PHASE_DRAW);
+          theScene->display();
+          theProfiler.end(PHASE_DRAW);
+        glPopMatrix();
+    }
+
+    if (theProfiler.isHUDVisible())
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        theProfiler.drawHUD(viewport[2], viewport[3]);
+    }
+    if (theCapture.isActive())
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        theCapture.capture(viewport[2], viewport[3]);
+    }
 
     // check for any errors when rendering
     GLenum errorCode = glGetError();
     if (errorCode == GL_NO_ERROR)
     {
         // double-buffering - swap back and front buffers
+        TRACE_SCOPE("swap");
+        theProfiler.begin(PHASE_SWAP);
         glFlush();
+        // all processes of a wall show the same tick at once
+        if (theMaster != NULL)
+        {
+            theMaster->swapBarrier();
+        }
+        else if (theNode != NULL)
+        {
+            theNode->swapBarrier();
+        }
         glutSwapBuffers();
+        theProfiler.end(PHASE_SWAP);
     }
     else
     {
         reportError(errorCode);
     }
+    countDraws();
+    theProfiler.endFrame();
 }
 
 
@@ -258,6 +507,35 @@ void onAlphaNumericKeyPress (unsigned char key, int x, int y)
         theScene->update();
         break;
 
+      // toggle frame profiler HUD
+      case 'f':
+        theProfiler.toggleHUD();
+        break;
+
+      // switch between drawing meshes and splats
+      case 'x':
+        isSplatting = ! isSplatting;
+        break;
+
+      // grab a screenshot of the next frame
+      case 'g':
+        theCapture.requestScreenshot();
+        break;
+
+      // start or stop recording every frame
+      case 'v':
+        theCapture.toggleRecording();
+        break;
+
+      // print memory used per subsystem
+      case 'm':
+      {
+        MemoryReport report;
+        reportMemory(report);
+        report.print(cout);
+        break;
+      }
+
       // quit!
       case 'Q':
       case 'q':
@@ -383,12 +661,331 @@ void onVisible (int state)
 }
 
 
+/*
+ * Handles framework arguments left after GLUT has taken its own:
+ *   -wall COLSxROWS   render the view as a wall of tiles, one thread each
+ *   -tile WxH         size in pixels of each wall tile
+ *   -master ADDRESS   simulate and send each tick to render nodes
+ *   -node ADDRESS     draw the ticks sent by the master at ADDRESS
+ *   -splat            draw bodies as splats on the CPU ('x' toggles)
+ *   -trails           show trails of recent motion ('t' toggles)
+ *   -trail KIND TICKS show TICKS ticks of trail for sun, planet or moon
+ *   -trig ACCURACY    body angle sines and cosines: libm, precise (the
+ *                     default) or fast
+ *   -multirate PIXELS update slow or distant bodies less often, each
+ *                     kept within PIXELS of where it would be
+ *   -feed NAME        publish each tick to shared memory (see solar_feed.h)
+ *   -headless FRAMES  render FRAMES frames to files instead of a window
+ *   -size WxH         size in pixels of headless frames, unless -wall
+ *                     gives them as its tiles put together
+ *   -output PATTERN   printf pattern of frame files, .png or .ppm
+ *   -writers N        threads writing headless frames
+ *   -screenshot PATTERN  printf pattern of screenshot files ('g')
+ *   -record PATTERN   printf pattern of recordings ('v'): .y4m, .rgba,
+ *                     or .png/.ppm sequences given recording and frame
+ * where ADDRESS is unix:/path/to/socket or host:port.
+ */
+void parseArguments (int argc, char * argv[])
+{
+    for (int k = 1; k < argc; k++)
+    {
+        if (strcmp(argv[k], "-wall") == 0 && k + 1 < argc)
+        {
+            sscanf(argv[++k], "%dx%d", &theWallCols, &theWallRows);
+        }
+        else if (strcmp(argv[k], "-tile") == 0 && k + 1 < argc)
+        {
+            sscanf(argv[++k], "%dx%d", &theTileWidth, &theTileHeight);
+        }
+        else if (strcmp(argv[k], "-master") == 0 && k + 1 < argc)
+        {
+            theMaster = new ClusterMaster();
+            if (! theMaster->listen(argv[++k]))
+            {
+                cerr << "Could not listen for render nodes at " << argv[k] << endl;
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[k], "-headless") == 0 && k + 1 < argc)
+        {
+            theNumHeadlessFrames = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "-size") == 0 && k + 1 < argc)
+        {
+            sscanf(argv[++k], "%dx%d", &theImageWidth, &theImageHeight);
+        }
+        else if (strcmp(argv[k], "-output") == 0 && k + 1 < argc)
+        {
+            theOutputPattern = argv[++k];
+        }
+        else if (strcmp(argv[k], "-writers") == 0 && k + 1 < argc)
+        {
+            theNumWriters = max(1, atoi(argv[++k]));
+        }
+        else if (strcmp(argv[k], "-splat") == 0)
+        {
+            isSplatting = true;
+        }
+        else if (strcmp(argv[k], "-trails") == 0)
+        {
+            isShowingTrails = true;
+        }
+        else if (strcmp(argv[k], "-trail") == 0 && k + 2 < argc)
+        {
+            const char * KIND_NAMES[NUM_BODY_KINDS] = { "sun", "planet", "moon" };
+            for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+            {
+                if (strcmp(argv[k + 1], KIND_NAMES[kind]) == 0)
+                {
+                    theScene->getTrails().setLength(BodyKind(kind), atoi(argv[k + 2]));
+                }
+            }
+            isShowingTrails = true;
+            k += 2;
+        }
+        else if (strcmp(argv[k], "-trig") == 0 && k + 1 < argc)
+        {
+            const char * ACCURACY_NAMES[NUM_SINCOS_ACCURACIES] = { "libm", "precise", "fast" };
+            k++;
+            for (int accuracy = 0; accuracy < NUM_SINCOS_ACCURACIES; accuracy++)
+            {
+                if (strcmp(argv[k], ACCURACY_NAMES[accuracy]) == 0)
+                {
+                    theSinCosAccuracy = SinCosAccuracy(accuracy);
+                }
+            }
+        }
+        else if (strcmp(argv[k], "-multirate") == 0 && k + 1 < argc)
+        {
+            theMultiRatePixels = atof(argv[++k]);
+        }
+        else if (strcmp(argv[k], "-screenshot") == 0 && k + 1 < argc)
+        {
+            theScreenshotPattern = argv[++k];
+        }
+        else if (strcmp(argv[k], "-record") == 0 && k + 1 < argc)
+        {
+            theRecordPattern = argv[++k];
+        }
+        else if (strcmp(argv[k], "-feed") == 0 && k + 1 < argc)
+        {
+            theFeedName = argv[++k];
+        }
+        else if (strcmp(argv[k], "-node") == 0 && k + 1 < argc)
+        {
+            theNode = new ClusterNode();
+            if (! theNode->connect(argv[++k]))
+            {
+                cerr << "Could not connect to master at " << argv[k] << endl;
+                exit(1);
+            }
+        }
+    }
+}
+
+
+/*
+ * Shows trails from the first tick if they were requested.
+ */
+void startTrails ()
+{
+    if (isShowingTrails && ! theScene->getTrails().isShown())
+    {
+        theScene->getTrails().toggle();
+    }
+}
+
+
+/*
+ * Starts the tile threads if a wall was requested.
+ */
+void startTiles ()
+{
+    if (theWallCols <= 0 || theWallRows <= 0)
+    {
+        return;
+    }
+    Frustum wall = getWallFrustum(double(theWallCols * theTileWidth) /
+                                  double(theWallRows * theTileHeight));
+    if (theTiles.start(theWallCols, theWallRows, theTileWidth, theTileHeight, wall))
+    {
+        cout << "Rendering " << theWallCols << "x" << theWallRows << " tiles of "
+             << theTileWidth << "x" << theTileHeight << " pixels" << endl;
+    }
+    else
+    {
+        cerr << "Could not create tile contexts, rendering to the window only" << endl;
+    }
+}
+
+
+/*
+ * Creates the shared memory state feed, if one was requested, sized
+ * for the loaded scene.
+ */
+void startFeed ()
+{
+    if (! theFeedName.empty() &&
+        ! theFeed.create(theFeedName, theScene->getSolarSystem()->getBodyCount()))
+    {
+        cerr << "Could not create state feed " << theFeedName << endl;
+    }
+}
+
+
+/*
+ * Stops the tile threads before the program exits.
+ */
+void onExitTiles ()
+{
+    theTiles.stop();
+}
+
+
+/*
+ * Renders theNumHeadlessFrames frames offscreen, handing each to the
+ * writer threads, and reports the frame rate.
+ *
+ * Returns the program's exit status.
+ */
+int runHeadless (int argc, char * argv[])
+{
+    parseArguments(argc, argv);
+    OffscreenContext context;
+    if (! context.create(theImageWidth, theImageHeight))
+    {
+        cerr << "Could not create an offscreen context" << endl;
+        return 1;
+    }
+    onInit(argc, argv);
+    startFeed();
+    startTrails();
+    startTiles();
+    setPerspective(GL_RENDER);
+    // a wall's frames are the whole wall, put together from its tiles
+    int width = theTiles.isRunning() ? theTiles.getWidth() : theImageWidth;
+    int height = theTiles.isRunning() ? theTiles.getHeight() : theImageHeight;
+
+    ImageWriter writer;
+    // enough buffers to cover a burst of slow writes
+    writer.start(theNumWriters, 2 * theNumWriters + 2);
+    char fileName[1024];
+    double start = FrameProfiler::now();
+    for (int frame = 0; frame < theNumHeadlessFrames; frame++)
+    {
+        if (theMaster != NULL)
+        {
+            theMaster->acceptNodes();
+        }
+        updateScene();
+
+        if (theTiles.isRunning())
+        {
+            theProfiler.begin(PHASE_DRAW);
+            theTiles.renderFrame();
+            theProfiler.end(PHASE_DRAW);
+        }
+        else if (isSplatting)
+        {
+            renderSplats(theImageWidth, theImageHeight);
+        }
+        else
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glPushMatrix();
+              theProfiler.begin(PHASE_CAMERA);
+              theScene->setCamera();
+              theProfiler.end(PHASE_CAMERA);
+              theProfiler.begin(PHASE_CULL);
+              theScene->cull();
+              theProfiler.end(PHASE_CULL);
+              theProfiler.begin(PHASE_DRAW);
+              theScene->display();
+              theProfiler.end(PHASE_DRAW);
+            glPopMatrix();
+        }
+
+        // reading back stands in for swapping buffers
+        theProfiler.begin(PHASE_SWAP);
+        ImageFrame * image = writer.acquire(width, height);
+        if (theTiles.isRunning())
+        {
+            memcpy(&image->pixels[0], theTiles.getImage(), image->pixels.size());
+        }
+        else if (isSplatting)
+        {
+            memcpy(&image->pixels[0], theSplats->getImage(), image->pixels.size());
+        }
+        else
+        {
+            context.readPixels(&image->pixels[0]);
+        }
+        snprintf(fileName, sizeof(fileName), theOutputPattern.c_str(), frame);
+        writer.submit(image, fileName);
+        if (theMaster != NULL)
+        {
+            theMaster->swapBarrier();
+        }
+        theProfiler.end(PHASE_SWAP);
+        countDraws();
+        theProfiler.endFrame();
+    }
+    double rendered = FrameProfiler::now();
+    theTiles.stop();
+    writer.finish();
+    double finished = FrameProfiler::now();
+
+    char line[256];
+    snprintf(line, sizeof(line),
+             "Rendered %d frames of %dx%d: %.2f frames/sec rendering, "
+             "%.2f frames/sec including writes (%.1f ms waiting for writers)",
+             theNumHeadlessFrames, width, height,
+             theNumHeadlessFrames * 1000.0 / max(rendered - start, 0.001),
+             theNumHeadlessFrames * 1000.0 / max(finished - start, 0.001),
+             writer.getWaitMs());
+    cout << line << endl;
+    MemoryReport report;
+    reportMemory(report);
+    writer.reportMemory(report);
+    report.print(cout);
+    if (writer.getNumFailed() > 0)
+    {
+        cerr << "Could not write " << writer.getNumFailed() << " frames" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * Returns true if the given argument was passed.
+ */
+bool hasArgument (int argc, char * argv[], const char * name)
+{
+    for (int k = 1; k < argc; k++)
+    {
+        if (strcmp(argv[k], name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 //////////////////////////////////////////////////////////////////
 // Main Function
 //
 int main (int argc, char *argv[]) 
 {
     theProgramTitle = argv[0];
+    // dump frame profile however the program ends
+    atexit(onExit);
+    // render to files without ever opening a window
+    if (hasArgument(argc, argv, "-headless"))
+    {
+        return runHeadless(argc, argv);
+    }
 
     // initialize glut
     glutInit(&argc, argv);      
@@ -417,8 +1014,15 @@ int main (int argc, char *argv[])
     glutPassiveMotionFunc(onMouseMotion);
     glutMouseFunc(onMouseButtonChanged);
 
-    // initialize model
+    // initialize model, with the options it is set up from
+    parseArguments(argc, argv);
     onInit(argc, argv);
+    startFeed();
+    startTrails();
+    startTiles();
+    theCapture.setPatterns(theScreenshotPattern, theRecordPattern);
+    theCapture.setFrameRate(1000 / ANIMATION_DELAY);
+    atexit(onExitTiles);
 
     // give control over to glut to handle rendering and interaction
     glutMainLoop();
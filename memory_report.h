@@ -0,0 +1,161 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a report of the memory a running program holds,
+// in bytes and objects per subsystem (catalog strings, the body
+// store, the hierarchy, render buffers, recorders, ...).  Each part
+// of the program adds what it owns through its reportMemory(), and
+// the headline figure is bytes per body, which render nodes are
+// sized from.
+//
+// Sizes are what containers have reserved, not what they use, and
+// include GPU buffers the program allocated; the allocator's own
+// overhead and the driver's are left out.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef MEMORY_REPORT_H_
+#define MEMORY_REPORT_H_
+
+#include <cstdio>            // for snprintf
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/*
+ * Memory held by one subsystem.
+ */
+struct MemoryUsage
+{
+    string subsystem;
+    size_t bytes;
+    long objects;
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class MemoryReport
+{
+  private:
+    vector<MemoryUsage> myUsages;
+    int myNumBodies;
+
+  public:
+    MemoryReport ()
+      : myNumBodies(0)
+    {
+    }
+
+
+    /*
+     * Returns the heap bytes a vector has reserved.
+     */
+    template <typename T>
+    static size_t bytesOf (const vector<T>& v)
+    {
+        return v.capacity() * sizeof(T);
+    }
+
+
+    /*
+     * Returns the heap bytes a string holds outside itself (none when
+     * short enough to fit within).
+     */
+    static size_t bytesOf (const string& s)
+    {
+        const char * data = s.data();
+        const char * self = (const char *)&s;
+        return (data >= self && data < self + sizeof(s)) ? 0 : s.capacity() + 1;
+    }
+
+
+    /*
+     * Adds bytes and objects to a subsystem, listed in the order they
+     * were first added.
+     */
+    void add (const string& subsystem, size_t bytes, long objects)
+    {
+        for (size_t k = 0; k < myUsages.size(); k++)
+        {
+            if (myUsages[k].subsystem == subsystem)
+            {
+                myUsages[k].bytes += bytes;
+                myUsages[k].objects += objects;
+                return;
+            }
+        }
+        MemoryUsage usage = { subsystem, bytes, objects };
+        myUsages.push_back(usage);
+    }
+
+
+    /*
+     * Sets the body count bytes per body are found from.
+     */
+    void setBodyCount (int count)
+    {
+        myNumBodies = count;
+    }
+
+
+    int getBodyCount () const
+    {
+        return myNumBodies;
+    }
+
+
+    const vector<MemoryUsage>& getUsages () const
+    {
+        return myUsages;
+    }
+
+
+    size_t getTotalBytes () const
+    {
+        size_t total = 0;
+        for (size_t k = 0; k < myUsages.size(); k++)
+        {
+            total += myUsages[k].bytes;
+        }
+        return total;
+    }
+
+
+    /*
+     * Returns every subsystem's bytes over the body count, or 0 with no
+     * bodies.
+     */
+    double getBytesPerBody () const
+    {
+        return (myNumBodies > 0) ? double(getTotalBytes()) / myNumBodies : 0;
+    }
+
+
+    /*
+     * Prints one line per subsystem, then the total and bytes per body.
+     */
+    void print (ostream& out) const
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "%-16s %12s %10s %10s", "memory", "bytes", "objects", "per body");
+        out << line << endl;
+        for (size_t k = 0; k < myUsages.size(); k++)
+        {
+            const MemoryUsage& usage = myUsages[k];
+            snprintf(line, sizeof(line), "%-16s %12zu %10ld %10.1f",
+                     usage.subsystem.c_str(), usage.bytes, usage.objects,
+                     (myNumBodies > 0) ? double(usage.bytes) / myNumBodies : 0.0);
+            out << line << endl;
+        }
+        snprintf(line, sizeof(line), "%-16s %12zu %10d %10.1f",
+                 "total", getTotalBytes(), myNumBodies, getBytesPerBody());
+        out << line << endl;
+    }
+};
+
+#endif
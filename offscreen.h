@@ -0,0 +1,193 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines an OpenGL context that renders into a
+// framebuffer object instead of a window, so a scene can be drawn
+// on machines without a display.
+//
+// It uses Mesa's surfaceless EGL platform, which is only available
+// on Linux; elsewhere create() simply fails.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef OFFSCREEN_H_
+#define OFFSCREEN_H_
+
+#include <cstdlib>           // for setenv
+#include "cglx.h"
+#if defined(__linux__) && ! defined(DEF_USE_CGLX)
+  #define DEF_USE_EGL
+  #include <EGL/egl.h>
+  #include <EGL/eglext.h>
+#endif
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class OffscreenContext
+{
+  private:
+    int myWidth;
+    int myHeight;
+    GLuint myFramebuffer;
+    GLuint myRenderbuffers[2];
+#ifdef DEF_USE_EGL
+    EGLDisplay myDisplay;
+    EGLContext myContext;
+#endif
+
+    bool createContext ()
+    {
+#ifdef DEF_USE_EGL
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay == NULL)
+        {
+            return false;
+        }
+        myDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        EGLint major, minor;
+        if (myDisplay == EGL_NO_DISPLAY || ! eglInitialize(myDisplay, &major, &minor))
+        {
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+        myContext = eglCreateContext(myDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, NULL);
+        if (myContext == EGL_NO_CONTEXT)
+        {
+            eglTerminate(myDisplay);
+            return false;
+        }
+        return makeCurrent();
+#else
+        return false;
+#endif
+    }
+
+  public:
+    OffscreenContext ()
+      : myWidth(0),
+        myHeight(0),
+        myFramebuffer(0)
+    {
+        myRenderbuffers[0] = myRenderbuffers[1] = 0;
+#ifdef DEF_USE_EGL
+        myDisplay = EGL_NO_DISPLAY;
+        myContext = EGL_NO_CONTEXT;
+#endif
+    }
+
+
+    ~OffscreenContext ()
+    {
+        destroy();
+    }
+
+
+    /*
+     * Creates a context with a color and depth target of the given
+     * size and makes it current on the calling thread.
+     *
+     * If no hardware driver is usable, retries with Mesa's software
+     * rasterizer.  Returns false if no context could be created.
+     */
+    bool create (int width, int height)
+    {
+#ifdef DEF_USE_EGL
+        if (! createContext())
+        {
+            setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+            if (! createContext())
+            {
+                return false;
+            }
+        }
+        myWidth = width;
+        myHeight = height;
+
+        glGenRenderbuffers(2, myRenderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, myRenderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, myRenderbuffers[1]);
+        // float depth, which reversed depth (see frustum.h) makes the most of
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+        glGenFramebuffers(1, &myFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, myFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  GL_RENDERBUFFER, myRenderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER, myRenderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            destroy();
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    /*
+     * Makes this context current on the calling thread.
+     */
+    bool makeCurrent ()
+    {
+#ifdef DEF_USE_EGL
+        return eglMakeCurrent(myDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, myContext);
+#else
+        return false;
+#endif
+    }
+
+
+    /*
+     * Releases the GL objects and the context.
+     */
+    void destroy ()
+    {
+#ifdef DEF_USE_EGL
+        if (myContext != EGL_NO_CONTEXT)
+        {
+            makeCurrent();
+            if (myFramebuffer != 0)
+            {
+                glDeleteFramebuffers(1, &myFramebuffer);
+                glDeleteRenderbuffers(2, myRenderbuffers);
+                myFramebuffer = 0;
+            }
+            eglMakeCurrent(myDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(myDisplay, myContext);
+            myContext = EGL_NO_CONTEXT;
+        }
+#endif
+    }
+
+
+    int getWidth () const
+    {
+        return myWidth;
+    }
+
+
+    int getHeight () const
+    {
+        return myHeight;
+    }
+
+
+    /*
+     * Copies the color target into pixels as tightly packed RGBA rows,
+     * bottom row first.
+     */
+    void readPixels (unsigned char * pixels)
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, myWidth, myHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+};
+
+#endif
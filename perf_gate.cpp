@@ -0,0 +1,470 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This is the main file of the performance regression gate.  It
+// compares benchmark results against a stored baseline and exits
+// non-zero if any benchmark got significantly slower.
+//
+// A benchmark regresses when both
+//   - a one-sided Mann-Whitney U test says the new samples are
+//     larger than the baseline samples (p < SIGNIFICANCE), and
+//   - its median slowed down by more than its threshold.
+// The threshold is the larger of the one configured for the
+// benchmark's name prefix and a multiple of the baseline's own
+// noise, so noisy benchmarks do not fail on jitter alone.
+//
+// A benchmark may also have a ceiling: a median it must never exceed,
+// whatever the baseline says or whether there is one (e.g., 0 for
+// allocations per frame).  Going over it always fails.
+//
+// If both files contain the CALIBRATION benchmark, new samples are
+// first scaled by how much slower or faster its fastest run was, which
+// removes most of the difference between machines.  Its fastest run
+// is the one least disturbed by whatever else the machine was doing;
+// its median can be thrown far off by a busy moment.  A calibration
+// whose median is far above its fastest run was measured while the
+// machine was busy, though, and says little about the rest of the
+// run, so then nothing is scaled.
+//
+// With --strict, a benchmark the baseline does not have fails too,
+// so a baseline left behind by new benchmarks cannot pass them
+// unchecked; run "make baseline" to add them.
+//
+// With --recheck, a benchmark that regressed in results.json only
+// fails if it regressed in a second run's results as well, so one
+// busy moment on the machine cannot fail the gate on its own.
+//
+// Usage: solargate [--strict] [--recheck again.json] baseline.json
+//                  results.json [thresholds.txt]
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#include <math.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <map>
+using namespace std;
+#include "benchmark.h"
+
+
+//////////////////////////////////////////////////////////////////
+// Globals
+//
+// Constants
+//
+const double SIGNIFICANCE = 0.01;         // one-sided p-value needed
+const double DEFAULT_THRESHOLD = 15;      // percent slowdown allowed
+const double NOISE_MULTIPLE = 3;          // threshold >= this many robust CVs
+const double CALIBRATION_SPREAD = 0.1;    // median over fastest calibration run trusted
+const char * CALIBRATION = "calibration/reference";
+// threshold, and ceiling if any, for each name prefix; the longest
+// match wins
+map<string, double> theThresholds;
+map<string, double> theCeilings;
+
+
+//////////////////////////////////////////////////////////////////
+//  Utility functions
+//
+/*
+ * Returns the one-sided p-value that samples b tend to be larger than
+ * samples a, using the normal approximation to the Mann-Whitney U
+ * distribution with tie and continuity corrections.
+ */
+double mannWhitneyGreater (const vector<double>& a, const vector<double>& b)
+{
+    size_t n1 = a.size(), n2 = b.size();
+    if (n1 < 2 || n2 < 2)
+    {
+        return 1;
+    }
+    // rank the pooled samples, averaging ranks of ties
+    vector< pair<double, int> > pooled;
+    for (size_t k = 0; k < n1; k++)
+    {
+        pooled.push_back(make_pair(a[k], 0));
+    }
+    for (size_t k = 0; k < n2; k++)
+    {
+        pooled.push_back(make_pair(b[k], 1));
+    }
+    sort(pooled.begin(), pooled.end());
+    size_t n = pooled.size();
+    double rankSumB = 0, tieTerm = 0;
+    for (size_t start = 0; start < n; )
+    {
+        size_t end = start;
+        while (end < n && pooled[end].first == pooled[start].first)
+        {
+            end++;
+        }
+        double rank = (start + 1 + end) / 2.0;
+        for (size_t k = start; k < end; k++)
+        {
+            if (pooled[k].second == 1)
+            {
+                rankSumB += rank;
+            }
+        }
+        double t = double(end - start);
+        tieTerm += t * t * t - t;
+        start = end;
+    }
+    double u = rankSumB - n2 * (n2 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (double(n) * (n - 1)));
+    if (variance <= 0)
+    {
+        return 1;
+    }
+    double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+
+/*
+ * Returns true if the benchmark's median is within CALIBRATION_SPREAD
+ * of its fastest run.
+ */
+bool isSteady (const BenchmarkResult& r)
+{
+    return r.minimum > 0 && r.median <= (1 + CALIBRATION_SPREAD) * r.minimum;
+}
+
+
+/*
+ * Returns the median absolute deviation scaled to match a standard
+ * deviation, relative to the median.
+ */
+double robustNoise (const BenchmarkResult& r)
+{
+    if (r.samples.size() < 2 || r.median == 0)
+    {
+        return 0;
+    }
+    vector<double> deviations;
+    for (size_t k = 0; k < r.samples.size(); k++)
+    {
+        deviations.push_back(fabs(r.samples[k] - r.median));
+    }
+    sort(deviations.begin(), deviations.end());
+    size_t m = deviations.size();
+    double mad = (m % 2) ? deviations[m / 2] : (deviations[m / 2 - 1] + deviations[m / 2]) / 2;
+    return 1.4826 * mad / r.median;
+}
+
+
+/*
+ * Returns the configured slowdown threshold in percent for a name.
+ */
+double configuredThreshold (const string& name)
+{
+    double threshold = DEFAULT_THRESHOLD;
+    size_t longest = 0;
+    map<string, double>::const_iterator it;
+    for (it = theThresholds.begin(); it != theThresholds.end(); it++)
+    {
+        if (name.compare(0, it->first.size(), it->first) == 0 && it->first.size() >= longest)
+        {
+            longest = it->first.size();
+            threshold = it->second;
+        }
+    }
+    return threshold;
+}
+
+
+/*
+ * Returns true and sets ceiling to the ceiling configured for a name,
+ * if any.
+ */
+bool findCeiling (const string& name, double& ceiling)
+{
+    bool isFound = false;
+    size_t longest = 0;
+    map<string, double>::const_iterator it;
+    for (it = theCeilings.begin(); it != theCeilings.end(); it++)
+    {
+        if (name.compare(0, it->first.size(), it->first) == 0 && it->first.size() >= longest)
+        {
+            longest = it->first.size();
+            ceiling = it->second;
+            isFound = true;
+        }
+    }
+    return isFound;
+}
+
+
+/*
+ * Scales results by how much slower or faster the calibration ran
+ * than in the baseline (see above), if both have it and it was steady
+ * in both.
+ */
+void scaleToBaseline (vector<BenchmarkResult>& results, const vector<BenchmarkResult>& baseline)
+{
+    const BenchmarkResult * base = NULL;
+    for (size_t k = 0; k < baseline.size(); k++)
+    {
+        if (baseline[k].name == CALIBRATION)
+        {
+            base = &baseline[k];
+        }
+    }
+    double speed = 1;
+    for (size_t k = 0; k < results.size(); k++)
+    {
+        if (results[k].name == CALIBRATION && base != NULL)
+        {
+            if (! isSteady(*base) || ! isSteady(results[k]))
+            {
+                printf("Calibration was not steady (median %.3f and %.3f over fastest %.3f and %.3f), "
+                       "results not scaled\n", base->median, results[k].median, base->minimum,
+                       results[k].minimum);
+            }
+            else
+            {
+                speed = results[k].minimum / base->minimum;
+            }
+        }
+    }
+    if (speed != 1)
+    {
+        printf("Machine speed relative to baseline: %.3f (results scaled to match)\n", 1 / speed);
+        for (size_t k = 0; k < results.size(); k++)
+        {
+            if (results[k].name != CALIBRATION && results[k].samples.size() > 1)
+            {
+                for (size_t s = 0; s < results[k].samples.size(); s++)
+                {
+                    results[k].samples[s] /= speed;
+                }
+                results[k].summarize();
+            }
+        }
+    }
+}
+
+
+/*
+ * Returns true if now regressed against base (see above), and sets
+ * the change in its median, the limit it was held to, both in
+ * percent, and the p-value of it being slower.
+ */
+bool isRegression (const BenchmarkResult& base, const BenchmarkResult& now,
+                   double& change, double& limit, double& p)
+{
+    change = (base.median > 0) ? 100 * (now.median / base.median - 1)
+                               : (now.median > 0) ? HUGE_VAL : 0;
+    limit = max(configuredThreshold(now.name), 100 * NOISE_MULTIPLE * robustNoise(base));
+    // single measurements (counts, error bounds) have no distribution to test
+    bool isSingle = base.samples.size() < 2 || now.samples.size() < 2;
+    p = isSingle ? 0 : mannWhitneyGreater(base.samples, now.samples);
+    return change > limit && p < SIGNIFICANCE;
+}
+
+
+/*
+ * Reads "prefix percent [ceiling]" lines; '#' starts a comment.
+ */
+bool readThresholds (const char * fileName)
+{
+    ifstream in(fileName);
+    if (! in)
+    {
+        return false;
+    }
+    string line;
+    while (getline(in, line))
+    {
+        line = line.substr(0, line.find('#'));
+        istringstream fields(line);
+        string prefix;
+        double percent;
+        double ceiling;
+        if (fields >> prefix >> percent)
+        {
+            theThresholds[prefix] = percent;
+            if (fields >> ceiling)
+            {
+                theCeilings[prefix] = ceiling;
+            }
+        }
+    }
+    return true;
+}
+
+
+//////////////////////////////////////////////////////////////////
+// Main Function
+//
+int main (int argc, char *argv[])
+{
+    const char * program = argv[0];
+    bool isStrict = false;
+    const char * recheckFile = NULL;
+    while (argc > 1 && argv[1][0] == '-')
+    {
+        if (string(argv[1]) == "--strict")
+        {
+            isStrict = true;
+        }
+        else if (string(argv[1]) == "--recheck" && argc > 2)
+        {
+            recheckFile = argv[2];
+            argc--;
+            argv++;
+        }
+        else
+        {
+            break;
+        }
+        argc--;
+        argv++;
+    }
+    if (argc < 3 || argc > 4)
+    {
+        cerr << "Usage: " << program << " [--strict] [--recheck again.json] baseline.json results.json"
+             << " [thresholds.txt]" << endl;
+        return 2;
+    }
+    vector<BenchmarkResult> baseline, current, again;
+    BenchmarkReader reader;
+    if (! reader.read(argv[1], baseline))
+    {
+        cerr << "Could not read baseline " << argv[1] << endl;
+        return 2;
+    }
+    if (! reader.read(argv[2], current))
+    {
+        cerr << "Could not read results " << argv[2] << endl;
+        return 2;
+    }
+    if (recheckFile != NULL && ! reader.read(recheckFile, again))
+    {
+        cerr << "Could not read results " << recheckFile << endl;
+        return 2;
+    }
+    if (argc == 4 && ! readThresholds(argv[3]))
+    {
+        cerr << "Could not read thresholds " << argv[3] << endl;
+        return 2;
+    }
+
+    map<string, const BenchmarkResult *> byName;
+    for (size_t k = 0; k < baseline.size(); k++)
+    {
+        byName[baseline[k].name] = &baseline[k];
+    }
+    map<string, const BenchmarkResult *> againByName;
+    for (size_t k = 0; k < again.size(); k++)
+    {
+        againByName[again[k].name] = &again[k];
+    }
+
+    // normalize for machine speed using the calibration workload
+    scaleToBaseline(current, baseline);
+    if (recheckFile != NULL)
+    {
+        scaleToBaseline(again, baseline);
+    }
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-32s %11s %11s %8s %8s %9s  %s",
+             "benchmark", "base (ms)", "new (ms)", "change", "limit", "p-value", "status");
+    cout << line << endl;
+    int numRegressions = 0, numOverCeiling = 0, numUnchecked = 0;
+    for (size_t k = 0; k < current.size(); k++)
+    {
+        const BenchmarkResult& now = current[k];
+        double ceiling;
+        bool isOverCeiling = findCeiling(now.name, ceiling) && now.median > ceiling;
+        if (isOverCeiling)
+        {
+            numOverCeiling++;
+        }
+        map<string, const BenchmarkResult *>::iterator found = byName.find(now.name);
+        if (found == byName.end())
+        {
+            const char * status = "new";
+            if (isOverCeiling)
+            {
+                status = "OVER CEILING";
+            }
+            else if (isStrict)
+            {
+                status = "NO BASELINE";
+                numUnchecked++;
+            }
+            snprintf(line, sizeof(line), "%-32s %11s %11.4f %8s %8s %9s  %s",
+                     now.name.c_str(), "-", now.median, "-", "-", "-", status);
+            cout << line << endl;
+            continue;
+        }
+        const BenchmarkResult& base = *found->second;
+        byName.erase(found);
+
+        double change, limit, p;
+        double median = now.median;
+        bool isRegressed = isRegression(base, now, change, limit, p);
+        bool isSingle = base.samples.size() < 2 || now.samples.size() < 2;
+        const char * status = "ok";
+        if (isOverCeiling)
+        {
+            status = "OVER CEILING";
+        }
+        else if (now.name == CALIBRATION)
+        {
+            // how fast the machine ran, not the code
+            status = "calibration";
+        }
+        else if (isRegressed && recheckFile != NULL && againByName.count(now.name) > 0 &&
+                 ! isRegression(base, *againByName[now.name], change, limit, p))
+        {
+            // what the second run found is shown
+            median = againByName[now.name]->median;
+            status = "not repeated";
+        }
+        else if (isRegressed)
+        {
+            status = "REGRESSION";
+            numRegressions++;
+        }
+        else if (change < -limit && (isSingle || mannWhitneyGreater(now.samples, base.samples) < SIGNIFICANCE))
+        {
+            status = "improved";
+        }
+        snprintf(line, sizeof(line), "%-32s %11.4f %11.4f %+7.1f%% %7.1f%% %9.2g  %s",
+                 now.name.c_str(), base.median, median, change, limit, p, status);
+        cout << line << endl;
+    }
+    map<string, const BenchmarkResult *>::iterator it;
+    for (it = byName.begin(); it != byName.end(); it++)
+    {
+        snprintf(line, sizeof(line), "%-32s %11.4f %11s %8s %8s %9s  %s",
+                 it->first.c_str(), it->second->median, "-", "-", "-", "-", "missing");
+        cout << line << endl;
+    }
+
+    if (numOverCeiling > 0)
+    {
+        cout << numOverCeiling << " benchmark(s) over their ceiling in " << argv[3] << endl;
+    }
+    if (numRegressions > 0)
+    {
+        cout << numRegressions << " benchmark(s) regressed against " << argv[1] << endl;
+    }
+    if (numUnchecked > 0)
+    {
+        cout << numUnchecked << " benchmark(s) not in " << argv[1] << endl;
+    }
+    if (numOverCeiling > 0 || numRegressions > 0 || numUnchecked > 0)
+    {
+        return 1;
+    }
+    cout << "No regressions against " << argv[1] << endl;
+    return 0;
+}
@@ -14,9 +14,14 @@
 #ifndef _THE_SCENE_H_
 #define _THE_SCENE_H_
 // include here so users do not have to later
+#include <cstring>           // for strcmp
+#include <cstdlib>           // for atoi
 #include "cglx.h"
 #include "solar_system.h"
+#include "batch_renderer.h"
+#include "trail_renderer.h"
 #include "vector_math.h"
+#include "trace.h"
 
 #ifndef LEFT_KEY
 #define LEFT_KEY 100
@@ -41,6 +46,36 @@ class Scene
     Point3 *myCamFrom;
     Point3 *myCamTo;
     Point3 *myCamUp;
+    // draws bodies grouped by kind instead of one at a time (see 'b')
+    BatchRenderer myBatches;
+    bool isBatching;
+    // recent positions of every body (see 't')
+    TrailRenderer myTrails;
+    // kept for every catalog loaded
+    SinCosAccuracy myAccuracy;
+    // the application's worker threads, started by init() (see -threads)
+    TaskScheduler *myScheduler;
+    // multi-rate updates, kept for every catalog loaded (see setMultiRate())
+    double myMaxError;
+    double myErrorPerDistance;
+    
+    /*
+     * Finds world positions for a newly loaded catalog and sorts its
+     * bodies for batching.
+     */
+    void setSolarSystem(SolarSystem *system) {
+        mySolarSystem = system;
+        mySolarSystem->setScheduler(myScheduler);
+        mySolarSystem->setSinCosAccuracy(myAccuracy);
+        if (myCamFrom != NULL)
+        {
+            mySolarSystem->setEye(*myCamFrom);
+        }
+        mySolarSystem->setMultiRate(myMaxError, myErrorPerDistance);
+        mySolarSystem->updateState();
+        myBatches.setBodies(mySolarSystem);
+        myTrails.setBodies(mySolarSystem);
+    }
     
     void setDefaultCamera() {
 		myCamFrom->set(DEFAULT_CAMERA_FROM);
@@ -60,14 +95,64 @@ class Scene
     static const Point3 DEFAULT_CAMERA_TO;
     static const Point3 DEFAULT_CAMERA_UP;
       
+    Scene ()
+      : mySolarSystem(NULL),
+        myCamFrom(NULL),
+        myCamTo(NULL),
+        myCamUp(NULL),
+        myScheduler(NULL),
+        myMaxError(-1),
+        myErrorPerDistance(0)
+    {
+    }
+
+
+    /*
+     * Shares the given scheduler's threads with the scene, for loading
+     * and simulation.  Call before init(), which starts it.
+     */
+    void setScheduler (TaskScheduler * scheduler)
+    {
+        myScheduler = scheduler;
+    }
+
+
+    TaskScheduler * getScheduler ()
+    {
+        return myScheduler;
+    }
+
+
     /*
      * Initialize general OpenGL values once (in place of constructor).
      *
      * This includes, for example, light and texture parameters.
+     *
+     * Starts the scheduler, if given, with "-threads n" threads in all
+     * (one per core by default), pinned to cores with "-pin".
      */
     virtual void init (GLfloat aspectRatio, int argc, char * argv[])
     {
-        mySolarSystem = new SolarSystem();
+        if (myScheduler != NULL)
+        {
+            int numThreads = 0;
+            bool isPinned = false;
+            for (int k = 1; k < argc; k++)
+            {
+                if (strcmp(argv[k], "-threads") == 0 && k + 1 < argc)
+                {
+                    numThreads = atoi(argv[++k]);
+                }
+                else if (strcmp(argv[k], "-pin") == 0)
+                {
+                    isPinned = true;
+                }
+            }
+            myScheduler->start(numThreads, isPinned);
+        }
+        myAccuracy = SINCOS_PRECISE;
+        setSolarSystem(new SolarSystem(SolarSystem::DEFAULT_CATALOG, myScheduler));
+        isBatching = true;
         
         myCamFrom = new Point3();
         myCamTo = new Point3();
@@ -77,17 +162,172 @@ class Scene
     }
 
 
+    SolarSystem * getSolarSystem ()
+    {
+        return mySolarSystem;
+    }
+
+
+    /*
+     * Replaces the solar system with one read from the given catalog.
+     */
+    void load (istream& catalog)
+    {
+        SolarSystem * old = mySolarSystem;
+        setSolarSystem(new SolarSystem(catalog, myScheduler));
+        delete old;
+    }
+
+
+    /*
+     * Extends the trails, if shown, after the solar system's angles
+     * change.  World positions are found only once something asks for
+     * them (see SolarSystem::getState()).
+     */
+    void refresh ()
+    {
+        if (myTrails.isShown())
+        {
+            myTrails.append(mySolarSystem->getState(), *myCamFrom);
+        }
+    }
+
+
+    /*
+     * Starts the simulation over from the catalog as loaded, with the
+     * orbits shown and the trails started over, as reloading it did.
+     */
+    void restart ()
+    {
+        mySolarSystem->restart();
+        mySolarSystem->toggleOrbit(true);
+        myTrails.setBodies(mySolarSystem);
+        refresh();
+    }
+
+
+    TrailRenderer& getTrails ()
+    {
+        return myTrails;
+    }
+
+
+    /*
+     * Sets how closely the sines and cosines of body angles match
+     * libm's, for this and every later catalog.
+     */
+    void setSinCosAccuracy (SinCosAccuracy accuracy)
+    {
+        myAccuracy = accuracy;
+        mySolarSystem->setSinCosAccuracy(accuracy);
+    }
+
+
+    /*
+     * Updates bodies only as often as keeps each within maxError plus
+     * errorPerDistance times its distance from the camera of where it
+     * would be, for this and every later catalog, or every tick again
+     * if maxError is negative (see SolarSystem::setMultiRate()).
+     */
+    void setMultiRate (double maxError, double errorPerDistance)
+    {
+        myMaxError = maxError;
+        myErrorPerDistance = errorPerDistance;
+        mySolarSystem->setEye(*myCamFrom);
+        mySolarSystem->setMultiRate(maxError, errorPerDistance);
+    }
+
+
+    /*
+     * Returns the draw calls and state changes issued by display()
+     * since the last call, summed over every thread that drew.
+     */
+    DrawStats takeDrawStats ()
+    {
+        return myBatches.takeStats();
+    }
+
+
+    /*
+     * Adds the catalog, render buffers and trails to report; render
+     * buffers of other threads' views are not counted.
+     */
+    void reportMemory (MemoryReport& report)
+    {
+        mySolarSystem->reportMemory(report);
+        myBatches.reportMemory(report);
+        myTrails.reportMemory(report);
+    }
+
+
+    /*
+     * Copies camera from, to and up positions into state (9 values).
+     */
+    void getCameraState (double state[9])
+    {
+        const Point3 * points[] = { myCamFrom, myCamTo, myCamUp };
+        for (int k = 0; k < 3; k++)
+        {
+            state[3 * k] = points[k]->x;
+            state[3 * k + 1] = points[k]->y;
+            state[3 * k + 2] = points[k]->z;
+        }
+    }
+
+
+    /*
+     * Sets camera from, to and up positions from state, as filled
+     * by getCameraState().
+     */
+    void setCameraState (const double state[9])
+    {
+        myCamFrom->set(state[0], state[1], state[2]);
+        myCamTo->set(state[3], state[4], state[5]);
+        myCamUp->set(state[6], state[7], state[8]);
+    }
+
+
+    /*
+     * Returns the camera position, which display() draws relative to.
+     */
+    const Point3& getEye () const
+    {
+        return *myCamFrom;
+    }
+
+
     /*
      * Set camera's view of scene.
+     *
+     * Only turns the view: the camera stays at the origin and display()
+     * moves the world by -getEye(), in double before anything becomes
+     * float, so bodies far from the world origin keep their precision.
      */
     virtual void setCamera ()
     {
-        gluLookAt(myCamFrom->x, myCamFrom->y, myCamFrom->z,        // from position
-                  myCamTo->x, myCamTo->y, myCamTo->z,          // to position
+        TRACE_SCOPE("Scene::setCamera");
+        gluLookAt(0, 0, 0,                                         // from position
+                  myCamTo->x - myCamFrom->x,                       // to position
+                  myCamTo->y - myCamFrom->y,
+                  myCamTo->z - myCamFrom->z,
                   myCamUp->x, myCamUp->y, myCamUp->z);         // up direction
     }
 
 
+    /*
+     * Decide what needs to be drawn before display is called.
+     *
+     * Timed separately from display so culling costs can be seen.
+     */
+    virtual void cull ()
+    {
+        if (isBatching)
+        {
+            myBatches.cull(*mySolarSystem, *myCamFrom);
+        }
+    }
+
+
     /*
      * Display all objects in the scene.
      *
@@ -95,7 +335,19 @@ class Scene
      */
     virtual void display ()
     {
-        mySolarSystem->draw();
+        if (isBatching)
+        {
+            myBatches.draw(*mySolarSystem, *myCamFrom);
+        }
+        else
+        {
+            glPushMatrix();
+              glTranslated(-myCamFrom->x, -myCamFrom->y, -myCamFrom->z);
+              mySolarSystem->draw();
+            glPopMatrix();
+            myBatches.count(myBatches.countImmediate(mySolarSystem->isOrbitShown()));
+        }
+        myBatches.count(myTrails.draw(*myCamFrom));
     }
 
 
@@ -106,7 +358,10 @@ class Scene
      */
     virtual void update ()
     {
+        // periods are chosen by distance from where the camera is now
+        mySolarSystem->setEye(*myCamFrom);
         mySolarSystem->animate();
+        refresh();
     }
 
 
@@ -133,6 +388,7 @@ class Scene
      */
     virtual void keyPressed (unsigned char key, int specialKey, int x, int y)
     {
+        TRACE_SCOPE("Scene::keyPressed");
         Vector3 viewDir = getViewDir();
     	Vector3 upDir;
         upDir.set(*myCamUp);
@@ -158,19 +414,31 @@ class Scene
                 // TODO: show orbits
             	mySolarSystem->toggleOrbit(true);
                 break;
+            // Start over, with the default camera, orbits shown and trails cleared
             case 'r':
-            {
-                // TODO: restart simulation
             	setDefaultCamera();
-                SolarSystem *toDelete = mySolarSystem;
-            	mySolarSystem = new SolarSystem();
-                delete toDelete; // To prevent memory leak from restarting solar system
+            	restart();
             	break;
-            }
             // Reset camera view
             case 'c':
             	setDefaultCamera();
             	break;
+            // Switch between batched and one-at-a-time drawing
+            case 'b':
+            	isBatching = ! isBatching;
+            	break;
+            // Switch drawing distant moons as impostors on and off
+            case 'l':
+            	myBatches.toggleLOD();
+            	break;
+            // Switch leaving out bodies hidden by large ones on and off
+            case 'k':
+            	myBatches.toggleOcclusion();
+            	break;
+            // Show or hide trails of recent motion
+            case 't':
+            	myTrails.toggle();
+            	break;
         }
         
         switch (specialKey)
@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines sine and cosine of angles in degrees, for many
+// angles at once, as every world position update needs.
+//
+// Angles are first reduced exactly: subtracting a whole number of
+// turns (or quarter turns) from a double in degrees loses nothing,
+// unlike libm's reduction of large radians, so the result does not
+// depend on how far an angle has been animated.  What is left, within
+// 45 degrees of zero, goes through a short polynomial chosen by the
+// accuracy wanted.  Each angle is independent and the loop has no
+// branches or calls, so the compiler runs several angles at a time.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef SINCOS_H_
+#define SINCOS_H_
+
+#include <math.h>
+
+/*
+ * How closely sinCosDegrees() matches sin() and cos().
+ */
+enum SinCosAccuracy
+{
+    // libm's sin() and cos(), one angle at a time
+    SINCOS_LIBM,
+    // within SINCOS_PRECISE_ERROR of libm
+    SINCOS_PRECISE,
+    // within SINCOS_FAST_ERROR of libm, plenty for drawing
+    SINCOS_FAST,
+    NUM_SINCOS_ACCURACIES
+};
+
+// largest difference from libm over any angle, measured by solarbench
+// (sincos/error/*)
+const double SINCOS_PRECISE_ERROR = 1e-15;
+const double SINCOS_FAST_ERROR = 4e-7;
+
+
+/*
+ * Returns an angle in degrees moved into [0, 360) without losing any
+ * precision.
+ */
+inline double wrapDegrees (double degrees)
+{
+    double wrapped = degrees - 360.0 * floor(degrees * (1 / 360.0));
+    // rounding in the quotient can leave it one turn off
+    if (wrapped >= 360)
+    {
+        wrapped -= 360;
+    }
+    else if (wrapped < 0)
+    {
+        wrapped += 360;
+    }
+    return wrapped;
+}
+
+
+/*
+ * Returns x rounded to the nearest whole number, for |x| < 2^51, in a
+ * way the compiler can vectorize (unlike rint() without SSE4.1).
+ */
+inline double roundNearest (double x)
+{
+    const double SHIFT = 6755399441055744.0;    // 1.5 * 2^52
+    return (x + SHIFT) - SHIFT;
+}
+
+
+/*
+ * Sine and cosine of x in [-pi/4, pi/4], by Taylor series to the
+ * given degrees.
+ */
+template <SinCosAccuracy ACCURACY>
+inline void sinCosPolynomial (double x, double& sine, double& cosine)
+{
+    double x2 = x * x;
+    if (ACCURACY == SINCOS_FAST)
+    {
+        // remainders below x^9 / 9! and x^10 / 10!
+        sine = x * (1 + x2 * (-1 / 6.0 + x2 * (1 / 120.0 + x2 * (-1 / 5040.0))));
+        cosine = 1 + x2 * (-1 / 2.0 + x2 * (1 / 24.0 + x2 * (-1 / 720.0 + x2 * (1 / 40320.0))));
+    }
+    else
+    {
+        // remainders below x^17 / 17! and x^18 / 18!
+        sine = x * (1 + x2 * (-1 / 6.0 + x2 * (1 / 120.0 + x2 * (-1 / 5040.0 +
+               x2 * (1 / 362880.0 + x2 * (-1 / 39916800.0 + x2 * (1 / 6227020800.0 +
+               x2 * (-1 / 1307674368000.0))))))));
+        cosine = 1 + x2 * (-1 / 2.0 + x2 * (1 / 24.0 + x2 * (-1 / 720.0 + x2 * (1 / 40320.0 +
+                 x2 * (-1 / 3628800.0 + x2 * (1 / 479001600.0 + x2 * (-1 / 87178291200.0 +
+                 x2 * (1 / 20922789888000.0))))))));
+    }
+}
+
+
+/*
+ * Sine and cosine of one angle in degrees, of any size.
+ */
+template <SinCosAccuracy ACCURACY>
+inline void sinCosDegrees (double degrees, double& sine, double& cosine)
+{
+    // whole turns, then whole quarter turns, come off exactly
+    double turns = roundNearest(degrees * (1 / 360.0));
+    double reduced = degrees - 360.0 * turns;
+    double quarters = roundNearest(reduced * (1 / 90.0));
+    reduced -= 90.0 * quarters;
+    double s, c;
+    sinCosPolynomial<ACCURACY>(reduced * (M_PI / 180.0), s, c);
+    // turn (s, c) by the quarter turns taken off
+    int quadrant = int(quarters) & 3;
+    double a = (quadrant & 1) ? c : s;
+    double b = (quadrant & 1) ? s : c;
+    sine = (quadrant & 2) ? -a : a;
+    cosine = ((quadrant + 1) & 2) ? -b : b;
+}
+
+
+/*
+ * Sines and cosines of count angles, in blocks of four so that even
+ * the cautious vectorizer -O2 uses packs each block.
+ */
+template <SinCosAccuracy ACCURACY>
+inline void sinCosBlocks (const double * degrees, int count, double * sines, double * cosines)
+{
+    int k = 0;
+    for (; k + 4 <= count; k += 4)
+    {
+        double s[4], c[4];
+        for (int i = 0; i < 4; i++)
+        {
+            sinCosDegrees<ACCURACY>(degrees[k + i], s[i], c[i]);
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            sines[k + i] = s[i];
+            cosines[k + i] = c[i];
+        }
+    }
+    for (; k < count; k++)
+    {
+        sinCosDegrees<ACCURACY>(degrees[k], sines[k], cosines[k]);
+    }
+}
+
+
+/*
+ * Sets sines[k] and cosines[k] to the sine and cosine of degrees[k],
+ * for count angles.
+ */
+inline void sinCosDegrees (const double * degrees, int count, double * sines, double * cosines,
+                           SinCosAccuracy accuracy = SINCOS_PRECISE)
+{
+    switch (accuracy)
+    {
+      case SINCOS_LIBM:
+        for (int k = 0; k < count; k++)
+        {
+            double radians = degrees[k] * (M_PI / 180.0);
+            sines[k] = sin(radians);
+            cosines[k] = cos(radians);
+        }
+        break;
+      case SINCOS_FAST:
+        sinCosBlocks<SINCOS_FAST>(degrees, count, sines, cosines);
+        break;
+      default:
+        sinCosBlocks<SINCOS_PRECISE>(degrees, count, sines, cosines);
+        break;
+    }
+}
+
+
+/*
+ * Sine and cosine of one angle in degrees, at the given accuracy.
+ */
+inline void sinCosDegrees (double degrees, double& sine, double& cosine,
+                           SinCosAccuracy accuracy = SINCOS_PRECISE)
+{
+    sinCosDegrees(&degrees, 1, &sine, &cosine, accuracy);
+}
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ * A basic framework designed for a monitor wall using CGLX.
+ *
+ * This file is the C API for reading the live body state that a
+ * running solarsystem publishes with -feed NAME.  It only needs
+ * POSIX shared memory and a C99 compiler (GCC or Clang atomics),
+ * so external viewers and analysis tools can include it without
+ * any other part of the framework.
+ *
+ * The feed is a ring of slots in shared memory.  Each slot holds
+ * one tick as arrays (ids, x, y, z, orbit and rotation angles)
+ * and is protected by a sequence lock: the writer makes the slot's
+ * sequence odd while copying into it and even again when done.
+ * Readers never block the writer; they read in place and then
+ * check the sequence did not change, retrying if it did.
+ *
+ *     struct solar_feed feed;
+ *     struct solar_feed_view view;
+ *     if (solar_feed_open("/solarsystem", &feed) == 0)
+ *     {
+ *         do
+ *         {
+ *             solar_feed_begin(&feed, &view);
+ *             ... read view.x[k], view.y[k], ... for k < view.count ...
+ *         }
+ *         while (! solar_feed_validate(&view));
+ *         solar_feed_close(&feed);
+ *     }
+ *
+ * Link with -lrt on systems whose C library lacks shm_open.
+ */
+#ifndef SOLAR_FEED_H_
+#define SOLAR_FEED_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOLAR_FEED_MAGIC    0x534f4c46u     /* "SOLF" */
+#define SOLAR_FEED_VERSION  1u
+#define SOLAR_FEED_ALIGN    64u
+
+/*
+ * Start of the shared memory, written once by the publisher.
+ */
+struct solar_feed_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;          /* bodies each slot can hold */
+    uint32_t num_slots;
+    uint64_t slot_offset;       /* bytes from start to first slot */
+    uint64_t slot_size;         /* bytes from one slot to the next */
+    uint64_t latest;            /* number of ticks published; newest is latest - 1 */
+};
+
+/*
+ * Start of each slot; the arrays follow at the offsets given by
+ * solar_feed_array_offset().
+ */
+struct solar_feed_slot
+{
+    uint64_t sequence;          /* odd while being written */
+    uint64_t tick;              /* simulation tick of this state */
+    uint32_t count;             /* bodies in this state */
+    uint32_t reserved;
+};
+
+enum solar_feed_array
+{
+    SOLAR_FEED_IDS,             /* uint32_t catalog position */
+    SOLAR_FEED_X,               /* double world position */
+    SOLAR_FEED_Y,
+    SOLAR_FEED_Z,
+    SOLAR_FEED_ORBIT_ANGLES,    /* double degrees, in [0, 360) */
+    SOLAR_FEED_ROTATION_ANGLES,
+    SOLAR_FEED_NUM_ARRAYS
+};
+
+struct solar_feed
+{
+    const struct solar_feed_header * header;
+    size_t size;
+};
+
+/*
+ * One tick as read in place from shared memory; only valid if
+ * solar_feed_validate() says so after the reader is done with it.
+ */
+struct solar_feed_view
+{
+    const struct solar_feed_slot * slot;
+    uint64_t sequence;
+    uint64_t tick;
+    uint32_t count;
+    const uint32_t * ids;
+    const double * x;
+    const double * y;
+    const double * z;
+    const double * orbit_angles;
+    const double * rotation_angles;
+};
+
+
+static inline size_t solar_feed_round (size_t bytes)
+{
+    return (bytes + SOLAR_FEED_ALIGN - 1) / SOLAR_FEED_ALIGN * SOLAR_FEED_ALIGN;
+}
+
+
+/*
+ * Returns the offset of an array from the start of its slot.
+ */
+static inline size_t solar_feed_array_offset (uint32_t capacity, int array)
+{
+    size_t offset = solar_feed_round(sizeof(struct solar_feed_slot));
+    if (array > SOLAR_FEED_IDS)
+    {
+        offset += solar_feed_round(capacity * sizeof(uint32_t)) +
+                  (array - 1) * solar_feed_round(capacity * sizeof(double));
+    }
+    return offset;
+}
+
+
+static inline size_t solar_feed_slot_size (uint32_t capacity)
+{
+    return solar_feed_array_offset(capacity, SOLAR_FEED_NUM_ARRAYS);
+}
+
+
+/*
+ * Maps the feed with the given name (e.g., "/solarsystem") read-only.
+ *
+ * Returns 0 on success, -1 if it does not exist or is not a feed.
+ */
+static inline int solar_feed_open (const char * name, struct solar_feed * feed)
+{
+    struct stat info;
+    void * memory;
+    int fd = shm_open(name, O_RDONLY, 0);
+    feed->header = NULL;
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(struct solar_feed_header))
+    {
+        close(fd);
+        return -1;
+    }
+    memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        return -1;
+    }
+    feed->header = (const struct solar_feed_header *)memory;
+    feed->size = info.st_size;
+    if (feed->header->magic != SOLAR_FEED_MAGIC || feed->header->version != SOLAR_FEED_VERSION ||
+        feed->header->slot_offset + feed->header->num_slots * feed->header->slot_size > feed->size)
+    {
+        munmap(memory, feed->size);
+        feed->header = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+
+static inline void solar_feed_close (struct solar_feed * feed)
+{
+    if (feed->header != NULL)
+    {
+        munmap((void *)feed->header, feed->size);
+        feed->header = NULL;
+    }
+}
+
+
+/*
+ * Returns the number of ticks published so far, e.g., to poll for
+ * a new one without reading it.
+ */
+static inline uint64_t solar_feed_latest (const struct solar_feed * feed)
+{
+    return __atomic_load_n(&feed->header->latest, __ATOMIC_ACQUIRE);
+}
+
+
+/*
+ * Points view at the newest tick.
+ *
+ * Returns 0, or -1 if nothing has been published yet.
+ */
+static inline int solar_feed_begin (const struct solar_feed * feed, struct solar_feed_view * view)
+{
+    const struct solar_feed_header * header = feed->header;
+    const char * base;
+    uint64_t latest;
+    uint32_t capacity = header->capacity;
+    do
+    {
+        latest = solar_feed_latest(feed);
+        if (latest == 0)
+        {
+            view->slot = NULL;
+            return -1;
+        }
+        base = (const char *)header + header->slot_offset +
+               ((latest - 1) % header->num_slots) * header->slot_size;
+        view->slot = (const struct solar_feed_slot *)base;
+        view->sequence = __atomic_load_n(&view->slot->sequence, __ATOMIC_ACQUIRE);
+    }
+    /* being written: the writer has wrapped around to it already */
+    while (view->sequence & 1);
+    view->tick = view->slot->tick;
+    view->count = view->slot->count;
+    view->ids = (const uint32_t *)(base + solar_feed_array_offset(capacity, SOLAR_FEED_IDS));
+    view->x = (const double *)(base + solar_feed_array_offset(capacity, SOLAR_FEED_X));
+    view->y = (const double *)(base + solar_feed_array_offset(capacity, SOLAR_FEED_Y));
+    view->z = (const double *)(base + solar_feed_array_offset(capacity, SOLAR_FEED_Z));
+    view->orbit_angles = (const double *)(base + solar_feed_array_offset(capacity, SOLAR_FEED_ORBIT_ANGLES));
+    view->rotation_angles = (const double *)(base + solar_feed_array_offset(capacity, SOLAR_FEED_ROTATION_ANGLES));
+    return 0;
+}
+
+
+/*
+ * Returns non-zero if nothing in view was overwritten while it was
+ * being read; otherwise the reader must begin again.
+ */
+static inline int solar_feed_validate (const struct solar_feed_view * view)
+{
+    if (view->slot == NULL)
+    {
+        return 0;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&view->slot->sequence, __ATOMIC_RELAXED) == view->sequence;
+}
+
+
+/*
+ * Copies up to max bodies' positions of the newest tick into x, y
+ * and z (any may be NULL), retrying until the copy is consistent.
+ *
+ * Returns the number of bodies copied, or -1 if nothing is published.
+ */
+static inline int solar_feed_copy_positions (const struct solar_feed * feed, double * x,
+                                             double * y, double * z, uint32_t max,
+                                             uint64_t * tick)
+{
+    struct solar_feed_view view;
+    uint32_t count;
+    do
+    {
+        if (solar_feed_begin(feed, &view) < 0)
+        {
+            return -1;
+        }
+        count = (view.count < max) ? view.count : max;
+        if (x != NULL) memcpy(x, view.x, count * sizeof(double));
+        if (y != NULL) memcpy(y, view.y, count * sizeof(double));
+        if (z != NULL) memcpy(z, view.z, count * sizeof(double));
+    }
+    while (! solar_feed_validate(&view));
+    if (tick != NULL)
+    {
+        *tick = view.tick;
+    }
+    return (int)count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,12 +4,22 @@
 #include "cglx.h"
 #include <vector>
 #include <string>
+#include <cstring>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <mutex>
 #include "space_objects.h"
+#include "arena.h"
+#include "memory_report.h"
+#include "body_state.h"
 #include "vector_math.h"
+#include "sincos.h"
+#include "task_scheduler.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -17,87 +27,654 @@ class SolarSystem
 {
   private:
     vector<SpaceObject*> *myObjects;
+    // every object, and every object's satellite list, in a few blocks
+    Arena myArena;
+    // while loading, each object's position in its parent's satellites
+    // (-1 for none); afterwards, empty
+    vector<int> myParents;
+    // every object's angles, in catalog order, and those as loaded,
+    // which restart() goes back to
+    BodyMotion *myMotions;
+    vector<BodyMotion> myInitialMotions;
+    // first object loaded with each name, so lookups do not scan every object
+    unordered_map<string, SpaceObject*> myNameIndex;
+    bool myShowOrbit;
+    // ticks animated so far
+    uint64_t myTick;
+    // state arrays filled by updateState(), and each body's world matrix
+    BodyState myState;
+    vector<Affine> myWorld;
+    // bumped whenever angles change, so what was found before is stale;
+    // the epoch updateState() last filled the state arrays in, the one
+    // it last found every world matrix in, and the epoch getWorld()
+    // last found each body in on its own
+    uint64_t myEpoch;
+    atomic<uint64_t> myStateEpoch;
+    atomic<uint64_t> myFullEpoch;
+    vector< atomic<uint64_t> > myWorldEpochs;
+    // the last epoch every body's angles may have changed in, and the
+    // epoch each body's world matrix last changed in, so after
+    // multi-rate ticks only the bodies they moved, and what orbits
+    // them, are found again
+    uint64_t myResetEpoch;
+    vector<uint64_t> myMoveEpochs;
+    // held while finding world matrices, which any thread may ask for;
+    // evaluateAll() runs the scheduler's tasks while holding it, so no
+    // task may take it, and it is taken last, with no other lock held
+    mutex myWorldLock;
+    // sine and cosine of every orbit angle, found together each update
+    SinCosAccuracy myAccuracy;
+    vector<double> mySines, myCosines;
+    // every object by depth in the hierarchy (suns, then what orbits
+    // them, ...), and where each depth starts, so each depth's world
+    // matrices can be found in parallel
+    vector<int> myLevelOrder;
+    vector<int> myLevelStarts;
+    // runs loading, animation and updates in parallel, if given
+    TaskScheduler *myScheduler;
+    
+    /*
+     * What multi-rate updates (see setMultiRate()) know of one body.
+     */
+    struct BodyRate
+    {
+        double orbitSpeed, rotationSpeed;
+        // farthest anything orbiting the body, at any depth, gets from it
+        double reach;
+        // nearest and farthest the body gets from its root, at any angles
+        double nearest, farthest;
+        int root;
+        // for a root, its distance from the eye when last rescheduled
+        double eyeDistance;
+        // the tick the body's angles were last brought up to
+        uint64_t lastTick;
+        // the period and phase it is updated at, as a group of myRateOrder
+        int group;
+        // its orbit center (-1 for none), whether anything orbits it,
+        // and where it is in its center's frame, as its world matrix
+        // was last found
+        int center;
+        bool isLeaf;
+        double offset[3];
+    };
+    
+    // while multi-rate, the error allowed, the eye it is measured from,
+    // each body's rate, and bodies grouped by period and phase, period
+    // P's phases starting at group P - 1, so the groups due each tick
+    // are found without looking at any body
+    bool isMultiRate;
+    double myMaxError, myErrorPerDistance;
+    Point3 myEye;
+    vector<BodyRate> myRates;
+    vector<int> myRateOrder;
+    vector<int> myRateStarts;
+    // share of bodies updated per tick, as last rescheduled
+    double myUpdateFraction;
+    
+    // objects, satellites of the root and catalog lines per task
+    static const int STATE_GRAIN = 4096;
+    static const int ANIMATE_GRAIN = 64;
+    static const int LOAD_GRAIN = 1024;
+    // catalog lines read before parsing them
+    static const int LOAD_CHUNK = 16384;
+    // most ticks between a body's updates (a power of two), and ticks
+    // between choosing every body's period again
+    static const int MAX_PERIOD = 64;
+    static const int RESCHEDULE_TICKS = 64;
+    
+    /*
+     * One catalog line, parsed.
+     */
+    struct CatalogEntry
+    {
+        string kind, name, center;
+        double rot, dist, size, oTilt, rTilt, oSpeed;
+        Vector3 rAxis, oAxis;
+    };
 	
-	void add(SpaceObject *obj)
+	/*
+	 * Calls body(first, last) over [0, count), on the scheduler's
+	 * threads if there is one.
+	 */
+	template <typename F>
+	void runParallel(int count, int grain, const F& body)
 	{
-		for(unsigned int k = 0; k<myObjects->size(); k++)
+		if(myScheduler == NULL)
 		{
-			string parentName = obj->getParentName();
-			if(((*myObjects)[k]->getName()).compare(parentName) == 0)
+			if(count > 0)
 			{
-				(*myObjects)[k]->add(obj);
+				body(0, count);
 			}
 		}
+		else
+		{
+			myScheduler->parallelFor(0, count, grain, body);
+		}
 	}
 	
-	SpaceObject* get(string name)
+	/*
+	 * Finds the world matrix of one body, once its orbit center's is
+	 * known.
+	 */
+	void findWorld(int k)
 	{
-		for(unsigned int k = 0; k<myObjects->size(); k++)
+		SpaceObject *obj = (*myObjects)[k];
+		SpaceObject *center = obj->getOrbitCenter();
+		Affine local = obj->localTransform(mySines[k], myCosines[k]);
+		if(center == NULL)
 		{
-			if((*myObjects)[k]->getName().compare(name) == 0)
-				return (*myObjects)[k];
+			myWorld[k] = local;
+		}
+		else
+		{
+			myWorld[k] = myWorld[center->getIndex()] * local;
+		}
+		if(isMultiRate)
+		{
+			myRates[k].offset[0] = local.getX();
+			myRates[k].offset[1] = local.getY();
+			myRates[k].offset[2] = local.getZ();
 		}
-		return NULL;
 	}
 	
-  public:
-	SolarSystem()
+	/*
+	 * Finds the world matrix and position of one body for the state
+	 * arrays.  A matrix getWorld() already found this epoch is kept, as
+	 * other threads may be reading it.
+	 */
+	void updateWorld(int k)
 	{
-		myObjects = new vector<SpaceObject*>();
-		try 
+		if(myWorldEpochs[k].load(memory_order_relaxed) != myEpoch)
 		{
-			ifstream myScanner;
-			myScanner.open("SolarSystem.txt");
-			while(true)
+			findWorld(k);
+		}
+		myState.x[k] = myWorld[k].getX();
+		myState.y[k] = myWorld[k].getY();
+		myState.z[k] = myWorld[k].getZ();
+	}
+	
+	/*
+	 * Brings one body's state up to date after multi-rate ticks alone,
+	 * since the state arrays were last filled at stateEpoch.  Only a
+	 * body whose own angles turned, or whose orbit center moved, since
+	 * then is found again, its sine and cosine only if it turned.  A
+	 * body nothing orbits, held while its center moved, is placed from
+	 * where it sits in its center's frame, which holding it leaves as
+	 * it was, and its world matrix is left for getWorld() to find.
+	 */
+	void updateMoved(int k, uint64_t stateEpoch)
+	{
+		const BodyRate& rate = myRates[k];
+		bool isTurned = rate.lastTick > myState.tick;
+		if(rate.isLeaf && !isTurned)
+		{
+			if(rate.center >= 0 && myMoveEpochs[rate.center] > stateEpoch)
 			{
-				string line;
-				getline(myScanner, line);
-				if(!myScanner.eof())
+				double p[3];
+				myWorld[rate.center].transformPoint(rate.offset[0], rate.offset[1], rate.offset[2], p);
+				myState.x[k] = p[0];
+				myState.y[k] = p[1];
+				myState.z[k] = p[2];
+			}
+			return;
+		}
+		if(isMoved(k))
+		{
+			if(isTurned)
+			{
+				sinCosDegrees(myMotions[k].orbitAngle, mySines[k], myCosines[k], myAccuracy);
+			}
+			findWorld(k);
+			myMoveEpochs[k] = myEpoch;
+		}
+		myWorldEpochs[k].store(myEpoch, memory_order_release);
+		if(isTurned || myMoveEpochs[k] > stateEpoch)
+		{
+			myState.orbitAngles[k] = myMotions[k].orbitAngle;
+			myState.rotationAngles[k] = myMotions[k].rotationAngle;
+			myState.x[k] = myWorld[k].getX();
+			myState.y[k] = myWorld[k].getY();
+			myState.z[k] = myWorld[k].getZ();
+		}
+	}
+	
+	/*
+	 * Returns true if the body's world matrix has been found since its
+	 * angles, or any orbit center's, last changed.
+	 */
+	bool isCurrent(int k)
+	{
+		return myFullEpoch.load(memory_order_acquire) == myEpoch ||
+		       myWorldEpochs[k].load(memory_order_acquire) == myEpoch;
+	}
+	
+	/*
+	 * Returns true if the body's world matrix may have changed since it
+	 * was last found: every body's angles have changed since, or its
+	 * own have, or its orbit center's matrix has.  Call holding
+	 * myWorldLock, once its orbit center is current.
+	 */
+	bool isMoved(int k)
+	{
+		uint64_t found = max(myWorldEpochs[k].load(memory_order_relaxed), myFullEpoch.load(memory_order_relaxed));
+		SpaceObject *center = (*myObjects)[k]->getOrbitCenter();
+		return myResetEpoch > found || myMoveEpochs[k] > found ||
+		       (center != NULL && myMoveEpochs[center->getIndex()] > found);
+	}
+	
+	/*
+	 * Finds the world matrix of one body, and of any orbit center above
+	 * it that is stale, on its own.  Call holding myWorldLock.
+	 */
+	void evaluate(int k)
+	{
+		if(isCurrent(k))
+		{
+			return;
+		}
+		SpaceObject *center = (*myObjects)[k]->getOrbitCenter();
+		if(center != NULL)
+		{
+			evaluate(center->getIndex());
+		}
+		if(isMoved(k))
+		{
+			sinCosDegrees(myMotions[k].orbitAngle, mySines[k], myCosines[k], myAccuracy);
+			findWorld(k);
+			myMoveEpochs[k] = myEpoch;
+		}
+		myWorldEpochs[k].store(myEpoch, memory_order_release);
+	}
+	
+	/*
+	 * Finds every body's world matrix and state, or, if only multi-rate
+	 * ticks have moved bodies since the state was last found, those
+	 * bodies' and what orbits them.  Call holding myWorldLock.
+	 */
+	void evaluateAll()
+	{
+		int count = getBodyCount();
+		uint64_t stateEpoch = myStateEpoch.load(memory_order_relaxed);
+		bool isAll = !isMultiRate || myResetEpoch > stateEpoch;
+		if(isAll)
+		{
+			runParallel(count, STATE_GRAIN, [this](int begin, int end)
+			{
+				for(int k = begin; k<end; k++)
+				{
+					myState.orbitAngles[k] = myMotions[k].orbitAngle;
+					myState.rotationAngles[k] = myMotions[k].rotationAngle;
+				}
+				sinCosDegrees(&myState.orbitAngles[begin], end - begin, &mySines[begin], &myCosines[begin], myAccuracy);
+			});
+		}
+		if(myScheduler == NULL || myScheduler->getNumThreads() <= 1)
+		{
+			for(int k = 0; k<count; k++)
+			{
+				if(isAll)
+				{
+					updateWorld(k);
+				}
+				else
+				{
+					updateMoved(k, stateEpoch);
+				}
+			}
+		}
+		else
+		{
+			for(size_t d = 0; d + 1<myLevelStarts.size(); d++)
+			{
+				const int *level = &myLevelOrder[myLevelStarts[d]];
+				runParallel(myLevelStarts[d + 1] - myLevelStarts[d], STATE_GRAIN, [this, level, isAll, stateEpoch](int begin, int end)
 				{
-					if(line[0] == '*')
-					{}
-					else 
+					for(int k = begin; k<end; k++)
 					{
-						stringstream ss(line);
-						vector<string> tokens = split(ss, ';');
-						stringstream ss2(stringstream::in | stringstream::out);
-						ss2 << tokens[5];
-						stringstream ss3(tokens[7].c_str());
-						vector<string> rAxisString = split(ss2, ' ');
-						vector<string> oAxisString = split(ss3, ' ');
-						
-						double rot = atof(tokens[2].c_str());
-						double dist = atof(tokens[3].c_str());
-						SpaceObject *oCenter = get(tokens[4]);
-						Vector3 *rAxis = new Vector3(atof(rAxisString[0].c_str()), atof(rAxisString[1].c_str()), atof(rAxisString[2].c_str()));
-						double size = atof(tokens[6].c_str());
-						string name = tokens[1];
-						Vector3 *oAxis = new Vector3(atof(oAxisString[0].c_str()), atof(oAxisString[1].c_str()), atof(oAxisString[2].c_str()));
-						double oTilt = atof(tokens[8].c_str());
-						double rTilt = atof(tokens[9].c_str());
-						double oSpeed = atof(tokens[10].c_str());
-						SpaceObject *obj;
-						
-						if(tokens[0].compare("Sun") == 0)
+						if(isAll)
 						{
-							obj = new Sun();
+							updateWorld(level[k]);
 						}
-						else if(tokens[0].compare("Planet") == 0)
+						else
 						{
-							obj = new Planet();
+							updateMoved(level[k], stateEpoch);
 						}
-						else 
-						{
-							obj = new Moon();
-						}
-						obj->setParameters(rot, dist, oCenter, *rAxis, size, name, *oAxis, oTilt, rTilt, oSpeed);
-						myObjects->push_back(obj);
-						add(obj);
+					}
+				});
+			}
+		}
+		myState.tick = myTick;
+		if(isAll)
+		{
+			myFullEpoch.store(myEpoch, memory_order_release);
+		}
+		myStateEpoch.store(myEpoch, memory_order_release);
+	}
+	
+	/*
+	 * Turns a body's angles on by every tick since it was last updated,
+	 * in one step, so a body updated rarely ends up where one updated
+	 * every tick would.  If its orbit angle changes, its world matrix
+	 * is marked changed in the current epoch, which must be newer than
+	 * any its matrix was found in; spin alone changes no world matrix.
+	 */
+	void catchUp(int k)
+	{
+		BodyRate& rate = myRates[k];
+		double ticks = double(myTick - rate.lastTick);
+		if(ticks > 0)
+		{
+			myMotions[k].orbitAngle = wrapDegrees(myMotions[k].orbitAngle + ticks * rate.orbitSpeed);
+			myMotions[k].rotationAngle = wrapDegrees(myMotions[k].rotationAngle + ticks * rate.rotationSpeed);
+			rate.lastTick = myTick;
+			if(rate.orbitSpeed != 0)
+			{
+				myMoveEpochs[k] = myEpoch;
+			}
+		}
+	}
+	
+	/*
+	 * Finds what does not change while multi-rate: speeds, and how near
+	 * to and far from its root each body and what orbits it can get.
+	 */
+	void findRates()
+	{
+		int count = getBodyCount();
+		myRates.resize(count);
+		for(int k = 0; k<count; k++)
+		{
+			SpaceObject *obj = (*myObjects)[k];
+			SpaceObject *center = obj->getOrbitCenter();
+			BodyRate& rate = myRates[k];
+			rate.orbitSpeed = obj->getOrbitSpeed();
+			rate.rotationSpeed = obj->getRotationSpeed();
+			rate.reach = 0;
+			rate.eyeDistance = 0;
+			rate.lastTick = myTick;
+			rate.center = (center == NULL) ? -1 : center->getIndex();
+			rate.isLeaf = (obj->getSatelliteCount() == 0);
+			rate.offset[0] = rate.offset[1] = rate.offset[2] = 0;
+			if(center == NULL)
+			{
+				rate.root = k;
+				rate.nearest = rate.farthest = 0;
+			}
+			else
+			{
+				// anywhere on a circle about wherever its center can be
+				const BodyRate& centerRate = myRates[center->getIndex()];
+				rate.root = centerRate.root;
+				rate.nearest = max(0.0, centerRate.nearest - obj->getDistance());
+				rate.farthest = centerRate.farthest + obj->getDistance();
+			}
+		}
+		// what orbits a body comes after it, so is done before it
+		for(int k = count - 1; k >= 0; k--)
+		{
+			SpaceObject *center = (*myObjects)[k]->getOrbitCenter();
+			if(center != NULL)
+			{
+				BodyRate& centerRate = myRates[center->getIndex()];
+				centerRate.reach = max(centerRate.reach, (*myObjects)[k]->getDistance() + myRates[k].reach);
+			}
+		}
+	}
+	
+	/*
+	 * Brings every body up to date, then gives each the longest period
+	 * that keeps the error allowed (see setMultiRate()) for it and all
+	 * that orbits it.  Holding a body's orbit angle for P - 1 ticks
+	 * moves it and what orbits it by at most that angle, in radians,
+	 * times its distance plus reach, and holding its spin moves its
+	 * surface by at most that angle times its size; orbit errors add up
+	 * down the hierarchy, so each depth gets its share of the error
+	 * allowed.
+	 */
+	void reschedule()
+	{
+		TRACE_SCOPE("SolarSystem::reschedule");
+		int count = getBodyCount();
+		runParallel(count, STATE_GRAIN, [this](int begin, int end)
+		{
+			for(int k = begin; k<end; k++)
+			{
+				catchUp(k);
+			}
+		});
+		int numLevels = max(1, int(myLevelStarts.size()) - 1);
+		int numGroups = 2 * MAX_PERIOD - 1;
+		myRateStarts.assign(numGroups + 1, 0);
+		double updates = 0;
+		for(int k = 0; k<count; k++)
+		{
+			BodyRate& rate = myRates[k];
+			if(rate.root == k)
+			{
+				// roots never orbit, so stay where they were loaded
+				const Affine& world = getWorld(k);
+				rate.eyeDistance = myEye.distance(Point3(world.getX(), world.getY(), world.getZ()));
+			}
+			double eyeDistance = myRates[rate.root].eyeDistance;
+			double nearest = max(0.0, rate.nearest - rate.reach);
+			double farthest = rate.farthest + rate.reach;
+			double allowed = myMaxError + myErrorPerDistance * max(0.0, max(nearest - eyeDistance, eyeDistance - farthest));
+			SpaceObject *obj = (*myObjects)[k];
+			double lag = (fabs(rate.orbitSpeed) * (obj->getDistance() + rate.reach) +
+			              fabs(rate.rotationSpeed) * obj->getSize()) * M_PI / 180.0;
+			int period = 1;
+			while(period < MAX_PERIOD && (2 * period - 1) * lag <= allowed / numLevels)
+			{
+				period *= 2;
+			}
+			rate.group = period - 1 + k % period;
+			myRateStarts[rate.group + 1]++;
+			updates += 1.0 / period;
+		}
+		for(int g = 0; g<numGroups; g++)
+		{
+			myRateStarts[g + 1] += myRateStarts[g];
+		}
+		// each start is moved on past its group as it fills, then back
+		myRateOrder.resize(count);
+		for(int k = 0; k<count; k++)
+		{
+			myRateOrder[myRateStarts[myRates[k].group]++] = k;
+		}
+		for(int g = numGroups; g>0; g--)
+		{
+			myRateStarts[g] = myRateStarts[g - 1];
+		}
+		myRateStarts[0] = 0;
+		myUpdateFraction = (count > 0) ? updates / count : 1;
+	}
+	
+	void add(SpaceObject *obj)
+	{
+		SpaceObject *parent = get(obj->getParentName());
+		myParents.push_back((parent == NULL) ? -1 : parent->getIndex());
+	}
+	
+	/*
+	 * Gives every object, once all are loaded, its slot in one arena
+	 * array of angles and its satellites as a run of another.
+	 */
+	void link()
+	{
+		int count = getBodyCount();
+		myMotions = myArena.allocateArray<BodyMotion>(max(count, 1));
+		for(int k = 0; k<count; k++)
+		{
+			myMotions[k].orbitAngle = 0;
+			myMotions[k].rotationAngle = 0;
+			(*myObjects)[k]->setMotion(&myMotions[k]);
+		}
+		// orbit centers come first, so each depth is one more than theirs
+		vector<int> depths(count, 0);
+		int numLevels = (count > 0) ? 1 : 0;
+		for(int k = 0; k<count; k++)
+		{
+			if(myParents[k] >= 0)
+			{
+				depths[k] = depths[myParents[k]] + 1;
+				numLevels = max(numLevels, depths[k] + 1);
+			}
+		}
+		myLevelStarts.assign(numLevels + 1, 0);
+		for(int k = 0; k<count; k++)
+		{
+			myLevelStarts[depths[k] + 1]++;
+		}
+		for(int d = 0; d<numLevels; d++)
+		{
+			myLevelStarts[d + 1] += myLevelStarts[d];
+		}
+		myLevelOrder.resize(count);
+		vector<int> nextInLevel(myLevelStarts.begin(), myLevelStarts.end() - 1);
+		for(int k = 0; k<count; k++)
+		{
+			myLevelOrder[nextInLevel[depths[k]]++] = k;
+		}
+		
+		vector<int> first(count + 1, 0);
+		for(int k = 0; k<count; k++)
+		{
+			if(myParents[k] >= 0)
+			{
+				first[myParents[k] + 1]++;
+			}
+		}
+		for(int k = 0; k<count; k++)
+		{
+			first[k + 1] += first[k];
+		}
+		SpaceObject **satellites = myArena.allocateArray<SpaceObject*>(max(first[count], 1));
+		vector<int> next(first.begin(), first.end() - 1);
+		for(int k = 0; k<count; k++)
+		{
+			if(myParents[k] >= 0)
+			{
+				satellites[next[myParents[k]]++] = (*myObjects)[k];
+			}
+		}
+		for(int k = 0; k<count; k++)
+		{
+			(*myObjects)[k]->setSatellites(satellites + first[k], first[k + 1] - first[k]);
+		}
+		vector<int>().swap(myParents);
+		
+		myState.resize(count);
+		myWorld.resize(count);
+		mySines.resize(count);
+		myCosines.resize(count);
+		vector< atomic<uint64_t> >(count).swap(myWorldEpochs);
+		myMoveEpochs.assign(count, 0);
+	}
+	
+	/*
+	 * Parses one catalog line into entry.
+	 */
+	void parse(const string& line, CatalogEntry& entry)
+	{
+		stringstream ss(line);
+		vector<string> tokens = split(ss, ';');
+		stringstream ss2(stringstream::in | stringstream::out);
+		ss2 << tokens[5];
+		stringstream ss3(tokens[7].c_str());
+		vector<string> rAxisString = split(ss2, ' ');
+		vector<string> oAxisString = split(ss3, ' ');
+		
+		entry.kind = tokens[0];
+		entry.rot = atof(tokens[2].c_str());
+		entry.dist = atof(tokens[3].c_str());
+		entry.center = tokens[4];
+		entry.rAxis = Vector3(atof(rAxisString[0].c_str()), atof(rAxisString[1].c_str()), atof(rAxisString[2].c_str()));
+		entry.size = atof(tokens[6].c_str());
+		entry.name = tokens[1];
+		entry.oAxis = Vector3(atof(oAxisString[0].c_str()), atof(oAxisString[1].c_str()), atof(oAxisString[2].c_str()));
+		entry.oTilt = atof(tokens[8].c_str());
+		entry.rTilt = atof(tokens[9].c_str());
+		entry.oSpeed = atof(tokens[10].c_str());
+	}
+	
+	/*
+	 * Makes an object from a parsed line, after its orbit center.
+	 */
+	void create(const CatalogEntry& entry)
+	{
+		SpaceObject *oCenter = get(entry.center);
+		SpaceObject *obj;
+		
+		if(entry.kind.compare("Sun") == 0)
+		{
+			obj = myArena.create<Sun>();
+		}
+		else if(entry.kind.compare("Planet") == 0)
+		{
+			obj = myArena.create<Planet>();
+		}
+		else 
+		{
+			obj = myArena.create<Moon>();
+		}
+		obj->setParameters(entry.rot, entry.dist, oCenter, entry.rAxis, entry.size, entry.name,
+		                   entry.oAxis, entry.oTilt, entry.rTilt, entry.oSpeed);
+		obj->setIndex(int(myObjects->size()));
+		myObjects->push_back(obj);
+		myNameIndex.insert(make_pair(entry.name, obj));
+		add(obj);
+	}
+	
+	/*
+	 * Reads one object per line from the given catalog.  A chunk of
+	 * lines at a time is parsed in parallel, then made into objects in
+	 * order, since each names an orbit center made before it.
+	 */
+	void load(istream& myScanner)
+	{
+		TRACE_SCOPE("SolarSystem::load");
+		try 
+		{
+			// grown to the lines read, up to a chunk, and reused for every
+			// chunk, so their strings keep their buffers
+			vector<string> lines;
+			vector<CatalogEntry> entries;
+			bool isDone = false;
+			while(!isDone)
+			{
+				int numLines = 0;
+				while(numLines < LOAD_CHUNK)
+				{
+					if(numLines == int(lines.size()))
+					{
+						lines.push_back(string());
+					}
+					getline(myScanner, lines[numLines]);
+					if(myScanner.eof())
+					{
+						isDone = true;
+						break;
+					}
+					if(lines[numLines][0] != '*')
+					{
+						numLines++;
 					}
 				}
-				else
-					break;
-				
+				if(numLines > int(entries.size()))
+				{
+					entries.resize(numLines);
+				}
+				runParallel(numLines, LOAD_GRAIN, [&](int begin, int end)
+				{
+					for(int k = begin; k<end; k++)
+					{
+						parse(lines[k], entries[k]);
+					}
+				});
+				for(int k = 0; k<numLines; k++)
+				{
+					create(entries[k]);
+				}
 			}
 			
 		}
@@ -105,31 +682,427 @@ class SolarSystem
 		{
 			cout << "BLAH" << endl;
 		}
+		link();
+		myInitialMotions.assign(myMotions, myMotions + getBodyCount());
+	}
+	
+  public:
+	static const char * DEFAULT_CATALOG;
+	
+	/*
+	 * Loads the given catalog, in parallel on scheduler if given.
+	 */
+	SolarSystem(const string& fileName = DEFAULT_CATALOG, TaskScheduler *scheduler = NULL)
+	{
+		myShowOrbit = true;
+		myTick = 0;
+		myEpoch = 1;
+		myStateEpoch = 0;
+		myFullEpoch = 0;
+		myResetEpoch = 1;
+		myAccuracy = SINCOS_PRECISE;
+		myScheduler = scheduler;
+		isMultiRate = false;
+		myMaxError = -1;
+		myErrorPerDistance = 0;
+		myUpdateFraction = 1;
+		myObjects = new vector<SpaceObject*>();
+		ifstream myScanner(fileName.c_str());
+		load(myScanner);
+	}
+	
+	SolarSystem(istream& catalog, TaskScheduler *scheduler = NULL)
+	{
+		myShowOrbit = true;
+		myTick = 0;
+		myEpoch = 1;
+		myStateEpoch = 0;
+		myFullEpoch = 0;
+		myResetEpoch = 1;
+		myAccuracy = SINCOS_PRECISE;
+		myScheduler = scheduler;
+		isMultiRate = false;
+		myMaxError = -1;
+		myErrorPerDistance = 0;
+		myUpdateFraction = 1;
+		myObjects = new vector<SpaceObject*>();
+		load(catalog);
+	}
+	
+	/*
+	 * Returns the first object loaded with the given name, or NULL.
+	 */
+	SpaceObject* get(const string& name)
+	{
+		unordered_map<string, SpaceObject*>::iterator it = myNameIndex.find(name);
+		return (it == myNameIndex.end()) ? NULL : it->second;
+	}
+	
+	int getBodyCount()
+	{
+		return int(myObjects->size());
+	}
+	
+	/*
+	 * Returns the object at the given position in catalog order.
+	 */
+	SpaceObject* getBody(int index)
+	{
+		return (*myObjects)[index];
 	}
 	
 	void draw()
 	{
+		TRACE_SCOPE("SolarSystem::draw");
 		(*myObjects)[0]->draw();
 	}
 	
 	void animate()
 	{
-		(*myObjects)[0]->animate();
+		TRACE_SCOPE("SolarSystem::animate");
+		if(isMultiRate)
+		{
+			animateDue();
+			return;
+		}
+		// each satellite of the root animates its own part of the tree
+		SpaceObject *root = (*myObjects)[0];
+		root->advance();
+		runParallel(root->getSatelliteCount(), ANIMATE_GRAIN, [root](int begin, int end)
+		{
+			for(int k = begin; k<end; k++)
+			{
+				root->getSatellite(k)->animate();
+			}
+		});
+		myTick++;
+		invalidate();
+	}
+	
+	/*
+	 * Moves on a tick, updating only the bodies due this tick, each by
+	 * every tick since it was last updated, and choosing every body's
+	 * period again every RESCHEDULE_TICKS ticks.  Only the bodies
+	 * updated, and what orbits them, are marked stale, so those held
+	 * keep their world matrices.
+	 */
+	void animateDue()
+	{
+		myTick++;
+		myEpoch++;
+		if(myTick % RESCHEDULE_TICKS == 0)
+		{
+			reschedule();
+		}
+		else
+		{
+			for(int period = 1; period <= MAX_PERIOD; period *= 2)
+			{
+				int group = period - 1 + int(myTick % period);
+				const int *due = &myRateOrder[myRateStarts[group]];
+				runParallel(myRateStarts[group + 1] - myRateStarts[group], STATE_GRAIN, [this, due](int begin, int end)
+				{
+					for(int k = begin; k<end; k++)
+					{
+						catchUp(due[k]);
+					}
+				});
+			}
+		}
+	}
+	
+	/*
+	 * Starts the simulation over from the angles as loaded, in one copy
+	 * rather than reading the catalog again.
+	 */
+	void restart()
+	{
+		TRACE_SCOPE("SolarSystem::restart");
+		memcpy(myMotions, myInitialMotions.data(), myInitialMotions.size() * sizeof(BodyMotion));
+		myTick = 0;
+		for(size_t k = 0; k<myRates.size(); k++)
+		{
+			myRates[k].lastTick = 0;
+		}
+		invalidate();
+	}
+	
+	/*
+	 * Fills the state arrays with every body's current angles and world
+	 * position now.  Orbit centers are always loaded before what orbits
+	 * them, so one pass in catalog order finds every world matrix; with
+	 * a scheduler, one parallel pass per depth in the hierarchy does.
+	 * After multi-rate ticks alone, only what they moved is found again
+	 * (see updateMoved()).  getState() does the same, only when angles
+	 * have changed since.
+	 */
+	void updateState()
+	{
+		TRACE_SCOPE("SolarSystem::updateState");
+		lock_guard<mutex> guard(myWorldLock);
+		evaluateAll();
+	}
+	
+	/*
+	 * Marks every world matrix stale after angles change, in one step
+	 * however many bodies there are.  animate() (unless multi-rate),
+	 * restart(), setAngles() and setSinCosAccuracy() call this; call it
+	 * after setting a body's angles directly.
+	 */
+	void invalidate()
+	{
+		myEpoch++;
+		myResetEpoch = myEpoch;
+	}
+	
+	/*
+	 * Runs animation and updates on the given scheduler from now on,
+	 * or on the calling thread alone if NULL.
+	 */
+	void setScheduler(TaskScheduler *scheduler)
+	{
+		myScheduler = scheduler;
+	}
+	
+	TaskScheduler* getScheduler()
+	{
+		return myScheduler;
+	}
+	
+	/*
+	 * Returns the state arrays for the current angles, finding every
+	 * body first if they have changed since.
+	 */
+	const BodyState& getState()
+	{
+		if(myStateEpoch.load(memory_order_acquire) != myEpoch)
+		{
+			lock_guard<mutex> guard(myWorldLock);
+			// another thread may have found them meanwhile
+			if(myStateEpoch.load(memory_order_relaxed) != myEpoch)
+			{
+				TRACE_SCOPE("SolarSystem::updateState");
+				evaluateAll();
+			}
+		}
+		return myState;
+	}
+	
+	/*
+	 * Returns the world matrix of the body at the given position in
+	 * catalog order, for the current angles.  If it is stale, only it
+	 * and its orbit centers are found, so asking for a few bodies costs
+	 * a few bodies' work however large the catalog.
+	 */
+	const Affine& getWorld(int index)
+	{
+		if(!isCurrent(index))
+		{
+			lock_guard<mutex> guard(myWorldLock);
+			evaluate(index);
+		}
+		return myWorld[index];
+	}
+	
+	/*
+	 * Returns the spin angle of the body at the given position in
+	 * catalog order, in degrees.
+	 */
+	double getRotationAngle(int index)
+	{
+		return myMotions[index].rotationAngle;
+	}
+	
+	/*
+	 * Returns the ticks animated since loading, or since restart().
+	 */
+	uint64_t getTick()
+	{
+		return myTick;
+	}
+	
+	/*
+	 * Sets how closely sines and cosines of every body's angles, found
+	 * in bulk by updateState() and batched drawing, match libm's.
+	 */
+	void setSinCosAccuracy(SinCosAccuracy accuracy)
+	{
+		myAccuracy = accuracy;
+		invalidate();
+	}
+	
+	SinCosAccuracy getSinCosAccuracy()
+	{
+		return myAccuracy;
+	}
+	
+	/*
+	 * Updates each body only as often as keeps it, and everything
+	 * orbiting it, within maxError plus errorPerDistance times its
+	 * distance from the eye (see setEye()) of where updating every tick
+	 * would put it: slow bodies, and those far from the eye, are
+	 * updated up to MAX_PERIOD ticks apart.  An update turns a body on
+	 * by every tick it missed, so the error never builds up; between
+	 * updates a body is held where it was, spin included.  Periods are
+	 * chosen from the eye as it was every RESCHEDULE_TICKS ticks.  Bodies far
+	 * from the eye project small, so errorPerDistance set to a pixel's
+	 * size at unit distance keeps every body within about a pixel.
+	 * With both 0 every moving body is updated every tick, as usual; a
+	 * negative maxError turns multi-rate updates off.
+	 */
+	void setMultiRate(double maxError, double errorPerDistance = 0)
+	{
+		if(maxError < 0)
+		{
+			if(isMultiRate)
+			{
+				runParallel(getBodyCount(), STATE_GRAIN, [this](int begin, int end)
+				{
+					for(int k = begin; k<end; k++)
+					{
+						catchUp(k);
+					}
+				});
+				invalidate();
+			}
+			isMultiRate = false;
+			myMaxError = -1;
+			vector<BodyRate>().swap(myRates);
+			vector<int>().swap(myRateOrder);
+			vector<int>().swap(myRateStarts);
+			myUpdateFraction = 1;
+			return;
+		}
+		myMaxError = maxError;
+		myErrorPerDistance = errorPerDistance;
+		if(!isMultiRate)
+		{
+			findRates();
+			isMultiRate = true;
+		}
+		// catching up marks bodies moved in an epoch nothing was found in
+		invalidate();
+		reschedule();
+	}
+	
+	/*
+	 * Returns the error multi-rate updates allow at the eye, or -1 if
+	 * every body is updated every tick.
+	 */
+	double getMaxError()
+	{
+		return myMaxError;
+	}
+	
+	/*
+	 * Sets where errors are seen from, e.g., the camera, which periods
+	 * are chosen for the next time they are.
+	 */
+	void setEye(const Point3& eye)
+	{
+		myEye = eye;
+	}
+	
+	/*
+	 * Returns the share of bodies animate() updates per tick: 1 unless
+	 * multi-rate.
+	 */
+	double getUpdateFraction()
+	{
+		return myUpdateFraction;
 	}
 	
 	void toggleOrbit(bool toggle)
 	{
+		myShowOrbit = toggle;
 		for(unsigned int k = 0; k<myObjects->size(); k++)
 		{
 			(*myObjects)[k]->toggleOrbit(toggle);
 		}
 	}
 	
+	bool isOrbitShown()
+	{
+		return myShowOrbit;
+	}
+	
+	/*
+	 * Copies every object's orbit and rotation angles, in catalog order,
+	 * into arrays of getBodyCount() elements.
+	 */
+	void getAngles(double *orbitAngles, double *rotationAngles)
+	{
+		for(unsigned int k = 0; k<myObjects->size(); k++)
+		{
+			orbitAngles[k] = myMotions[k].orbitAngle;
+			rotationAngles[k] = myMotions[k].rotationAngle;
+		}
+	}
+	
+	/*
+	 * Sets every object's angles from arrays filled as by getAngles(),
+	 * e.g., to show a state simulated elsewhere.
+	 */
+	void setAngles(const double *orbitAngles, const double *rotationAngles)
+	{
+		for(unsigned int k = 0; k<myObjects->size(); k++)
+		{
+			myMotions[k].orbitAngle = orbitAngles[k];
+			myMotions[k].rotationAngle = rotationAngles[k];
+		}
+		for(size_t k = 0; k<myRates.size(); k++)
+		{
+			myRates[k].lastTick = myTick;
+		}
+		invalidate();
+	}
+	
+	/*
+	 * Adds the memory of the loaded catalog to the report: names and
+	 * the index of them, the arena holding every body, what orbits
+	 * what, and the state found each update.
+	 */
+	void reportMemory(MemoryReport& report)
+	{
+		int count = getBodyCount();
+		size_t names = 0;
+		size_t satellites = 0;
+		for(int k = 0; k<count; k++)
+		{
+			names += MemoryReport::bytesOf((*myObjects)[k]->getName());
+			satellites += (*myObjects)[k]->getSatelliteCount();
+		}
+		// each index entry is a node holding its own copy of the name,
+		// the hash and a link to the next
+		size_t index = myNameIndex.bucket_count() * sizeof(void*) +
+		               myNameIndex.size() * (sizeof(pair<const string, SpaceObject*>) + sizeof(void*) + sizeof(size_t));
+		for(unordered_map<string, SpaceObject*>::iterator it = myNameIndex.begin(); it != myNameIndex.end(); it++)
+		{
+			index += MemoryReport::bytesOf(it->first);
+		}
+		report.add("catalog strings", names + index, long(count + myNameIndex.size()));
+		size_t links = satellites * sizeof(SpaceObject*);
+		report.add("body store", myArena.getCapacity() - links, count);
+		report.add("hierarchy", links + MemoryReport::bytesOf(*myObjects) + MemoryReport::bytesOf(myLevelOrder) +
+		           MemoryReport::bytesOf(myLevelStarts), long(satellites));
+		size_t state = MemoryReport::bytesOf(myState.ids) + MemoryReport::bytesOf(myState.x) +
+		               MemoryReport::bytesOf(myState.y) + MemoryReport::bytesOf(myState.z) +
+		               MemoryReport::bytesOf(myState.orbitAngles) + MemoryReport::bytesOf(myState.rotationAngles) +
+		               MemoryReport::bytesOf(myWorld) + MemoryReport::bytesOf(mySines) +
+		               MemoryReport::bytesOf(myCosines) + MemoryReport::bytesOf(myInitialMotions) +
+		               MemoryReport::bytesOf(myWorldEpochs) + MemoryReport::bytesOf(myMoveEpochs) +
+		               MemoryReport::bytesOf(myRates) + MemoryReport::bytesOf(myRateOrder) +
+		               MemoryReport::bytesOf(myRateStarts);
+		report.add("world state", state, myState.size());
+		report.setBodyCount(count);
+	}
+	
 	~SolarSystem()
 	{
+		// the arena frees their memory
 		for(unsigned int k = 0; k<myObjects->size(); k++)
 		{
-			delete (*myObjects)[k];
+			(*myObjects)[k]->~SpaceObject();
 		}
 		delete myObjects;
 	}
@@ -145,4 +1118,6 @@ class SolarSystem
 	}
 };
 
+const char * SolarSystem::DEFAULT_CATALOG = "SolarSystem.txt";
+
 #endif /* end of include guard: SOLAR_SYSTEM_H_PKR0MEI0 */
\ No newline at end of file
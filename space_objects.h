@@ -5,11 +5,14 @@
 #include <vector>
 #include "cglx.h"
 #include "vector_math.h"
+#include "geometry.h"
+#include "affine.h"
+#include "body_state.h"
+#include "sincos.h"
 
 class SpaceObject
 {
   protected:
-	double myRotationAngle;
     double myRotationSpeed;
     double myDistance;
     Vector3 myRotationAxis;
@@ -18,17 +21,28 @@ class SpaceObject
     Vector3 myOrbitAxis;
     double myOrbitTilt;
     double myRotationTilt;
-    double myOrbitAngle;
     double myOrbitSpeed;
     bool myShowOrbit;
+    // position in catalog order
+    int myIndex;
+    // the parts of transform() and draw() that only change with
+    // setParameters(): the tilted orbit plane and the unit spin axis
+    Affine myOrbitFrame;
+    Vector3 mySpinAxis;
+    
+    // the angles, in an array of every body's owned by the solar
+    // system (see setMotion())
+    BodyMotion *myMotion;
     
     SpaceObject *myOrbitCenter;
-    vector<SpaceObject*> *mySatellites;
+    // what orbits this object, in catalog order, owned by the solar
+    // system (see setSatellites())
+    SpaceObject **mySatellites;
+    int myNumSatellites;
 	
   public:
 	SpaceObject()
 	{
-		myRotationAngle = 0;
 		myRotationSpeed = 0;
 		myDistance = 0;
 		mySize = 0;
@@ -36,20 +50,23 @@ class SpaceObject
         // myOrbitAxis = NULL;
 		myOrbitTilt = 0;
 		myRotationTilt = 0;
-		myOrbitAngle = 0;
 		myOrbitSpeed = 0;
 		myShowOrbit = true;
+		myIndex = 0;
+		myOrbitFrame = Affine::identity();
+		myMotion = NULL;
+		myOrbitCenter = NULL;
 		
-		mySatellites = new vector<SpaceObject*>();
+		mySatellites = NULL;
+		myNumSatellites = 0;
 	}
 	
-	~SpaceObject()
+	virtual ~SpaceObject()
 	{
-        delete mySatellites;
 	}
 		
 	virtual void setParameters(double rot, double dist, SpaceObject *oCenter, 
-	    Vector3 rAxis, double size, string name, Vector3 oAxis, double oTilt, 
+	    const Vector3& rAxis, double size, const string& name, const Vector3& oAxis, double oTilt, 
 	    double rTilt, double oSpeed)
 	{
 		myRotationSpeed = rot;
@@ -62,37 +79,71 @@ class SpaceObject
 		myOrbitTilt = oTilt;
 		myRotationTilt = rTilt;
 		myOrbitSpeed = oSpeed;
+		updateFrames();
+	}
+	
+	/*
+	 * Finds the constant frames from the current parameters; called
+	 * whenever they change.
+	 */
+	virtual void updateFrames()
+	{
+		myOrbitFrame = Affine::rotation(myOrbitTilt, myOrbitAxis.x, myOrbitAxis.y, myOrbitAxis.z);
+		double length = myRotationAxis.length();
+		mySpinAxis = (length != 0) ? myRotationAxis / length : Vector3();
+	}
+	
+	/*
+	 * Sets the objects that orbit this one to the count starting at
+	 * satellites, which must outlive it.
+	 */
+	void setSatellites(SpaceObject **satellites, int count)
+	{
+		mySatellites = satellites;
+		myNumSatellites = count;
+	}
+	
+	/*
+	 * Keeps the angles in the given slot, which must outlive this
+	 * object, from now on.
+	 */
+	void setMotion(BodyMotion *motion)
+	{
+		myMotion = motion;
 	}
 	
-	virtual void add(SpaceObject *obj)
+	int getSatelliteCount()
 	{
-		mySatellites->push_back(obj);
+		return myNumSatellites;
+	}
+	
+	SpaceObject* getSatellite(int index)
+	{
+		return mySatellites[index];
 	}
 
 	virtual void draw() 
 	{	
 		if(myShowOrbit)
 		{
-		    vector<SpaceObject*>::iterator it;
-            for(it = mySatellites->begin(); it < mySatellites->end(); it++)
+            for(int k = 0; k<myNumSatellites; k++)
 			{
 				glPushMatrix();
-				(*it)->drawOrbit();
+				mySatellites[k]->drawOrbit();
 				glPopMatrix();
 			}
 		}
 		
 		glPushMatrix();
 		transform();
-		glRotated(myRotationAngle, myRotationAxis.x, myRotationAxis.y, myRotationAxis.z);
-		glutWireSphere(mySize, 20, 20);	//radius, slices, stacks
+		getSpin().apply();
+		wireSphere(mySize, 20, 20);	//radius, slices, stacks
 		glPopMatrix();
 		
-		vector<SpaceObject*>::iterator it;
-	    for(it = mySatellites->begin(); it < mySatellites->end(); it++)
+	    for(int k = 0; k<myNumSatellites; k++)
 		{
 			glPushMatrix();
-			(*it)->draw();
+			mySatellites[k]->draw();
 			glPopMatrix();
 		}
 	}
@@ -101,65 +152,174 @@ class SpaceObject
 	{
 		myOrbitCenter->transform();
 		colorOrbit();
-		glRotated(myOrbitTilt, myOrbitAxis.x, myOrbitAxis.y, myOrbitAxis.z);
+		myOrbitFrame.apply();
 		glTranslated(-myDistance, 0, 0);
-		glutWireTorus(myDistance, myDistance, 100, 1);
+		wireTorus(myDistance, myDistance, 100, 1);
 	}
 	
 	virtual void transform()
 	{
 		myOrbitCenter->transform();
-		glRotated(myOrbitTilt, myOrbitAxis.x, myOrbitAxis.y, myOrbitAxis.z);
-		glRotated(myOrbitAngle, 0, 1, 0);
+		myOrbitFrame.apply();
+		glRotated(myMotion->orbitAngle, 0, 1, 0);
 		glTranslated(myDistance, 0, 0);
 		colorObject();
 	}
 	
-	virtual void animate()
+	/*
+	 * Returns the matrix transform() multiplies onto its orbit
+	 * center's, so world positions can be found without OpenGL:
+	 * the constant orbit frame turned by the orbit angle.
+	 */
+	Affine localTransform()
 	{
-		myRotationAngle += myRotationSpeed;
-		myOrbitAngle += myOrbitSpeed;
-		
-	    vector<SpaceObject*>::iterator it;
-        for(it = mySatellites->begin(); it < mySatellites->end(); it++)
+		double radians = myMotion->orbitAngle * M_PI / 180.0;
+		return localTransform(sin(radians), cos(radians));
+	}
+	
+	/*
+	 * Same as localTransform(), given the sine and cosine of the orbit
+	 * angle, so those can be found for every body at once.
+	 */
+	virtual Affine localTransform(double orbitSine, double orbitCosine)
+	{
+		Affine local = myOrbitFrame;
+		local.rotateY(orbitSine, orbitCosine);
+		local.translate(myDistance, 0, 0);
+		return local;
+	}
+	
+	/*
+	 * Returns the rotation draw() applies about the spin axis.
+	 */
+	Affine getSpin()
+	{
+		return Affine::unitRotation(myMotion->rotationAngle, mySpinAxis.x, mySpinAxis.y, mySpinAxis.z);
+	}
+	
+	/*
+	 * Advances both angles by a tick, kept within [0, 360) so they
+	 * lose no precision however long the simulation runs.
+	 */
+	virtual void advance()
+	{
+		myMotion->rotationAngle = wrapDegrees(myMotion->rotationAngle + myRotationSpeed);
+		myMotion->orbitAngle = wrapDegrees(myMotion->orbitAngle + myOrbitSpeed);
+	}
+	
+	/*
+	 * Advances this object and everything orbiting it by a tick.
+	 */
+	void animate()
+	{
+		advance();
+        for(int k = 0; k<myNumSatellites; k++)
 		{
-			(*it)->animate();
+			mySatellites[k]->animate();
 		}
 	}
 
-	virtual string getName() 
+	virtual const string& getName() 
 	{
 		return myName;
 	}
 
-	virtual string getParentName() 
+	virtual const string& getParentName() 
 	{
 		return myOrbitCenter->getName();
 	}
 
+	virtual SpaceObject* getOrbitCenter() 
+	{
+		return myOrbitCenter;
+	}
+
+	int getIndex() 
+	{
+		return myIndex;
+	}
+
+	void setIndex(int index) 
+	{
+		myIndex = index;
+	}
+
+	virtual BodyKind getKind() = 0;
+
+	/*
+	 * Returns the color colorObject() draws with.
+	 */
+	virtual Color getColor() = 0;
+
+	virtual double getSize() 
+	{
+		return mySize;
+	}
+
 	virtual Vector3 getOrbitAxis() 
 	{
 		return myOrbitAxis;
 	}
 
+	virtual double getOrbitTilt() 
+	{
+		return myOrbitTilt;
+	}
+
+	virtual double getDistance() 
+	{
+		return myDistance;
+	}
+
 	virtual Vector3 getRotationAxis() 
 	{
 		return myRotationAxis;
 	}
 
+	/*
+	 * Returns the orbit plane's fixed tilt, onto which the orbit angle
+	 * turns the body.
+	 */
+	const Affine& getOrbitFrame() 
+	{
+		return myOrbitFrame;
+	}
+
+	/*
+	 * Returns the rotation axis at length 1, or 0 if it has none.
+	 */
+	const Vector3& getSpinAxis() 
+	{
+		return mySpinAxis;
+	}
+
 	virtual double getRotationSpeed() 
 	{
 		return myRotationSpeed;
 	}
 	
+	/*
+	 * Returns the degrees advance() turns the orbit angle by each tick.
+	 */
+	virtual double getOrbitSpeed() 
+	{
+		return myOrbitSpeed;
+	}
+	
 	virtual double getRotationAngle()
 	{
-		return myRotationAngle;
+		return myMotion->rotationAngle;
 	}
 
 	virtual double getOrbitAngle() 
 	{
-		return myOrbitAngle;
+		return myMotion->orbitAngle;
+	}
+
+	virtual void setAngles(double orbitAngle, double rotationAngle)
+	{
+		myMotion->orbitAngle = orbitAngle;
+		myMotion->rotationAngle = rotationAngle;
 	}
 
 	virtual void toggleOrbit(bool toggle) 
@@ -198,6 +358,16 @@ class Moon : public SpaceObject
 	{
 		glColor3d(MOON_COLOR.r, MOON_COLOR.g, MOON_COLOR.b);
 	}
+	
+	BodyKind getKind()
+	{
+		return KIND_MOON;
+	}
+	
+	Color getColor()
+	{
+		return MOON_COLOR;
+	}
 };
 
 class Planet : public SpaceObject
@@ -220,10 +390,23 @@ class Planet : public SpaceObject
 	{
 		glColor3d(PLANET_COLOR.r, PLANET_COLOR.g, PLANET_COLOR.b);
 	}
+	
+	BodyKind getKind()
+	{
+		return KIND_PLANET;
+	}
+	
+	Color getColor()
+	{
+		return PLANET_COLOR;
+	}
 };
 
 class Sun : public SpaceObject
 { 
+    // the orbit axis at length 1, or 0 if it has none
+    Vector3 myTurnAxis;
+    
   public:
       
     static const Color SUN_COLOR;
@@ -238,34 +421,65 @@ class Sun : public SpaceObject
 		//no axis
 	}
 	
+	/*
+	 * The sun tilts about x and then turns about its orbit axis.
+	 */
+	void updateFrames()
+	{
+		SpaceObject::updateFrames();
+		myOrbitFrame = Affine::rotation(myOrbitTilt, 1, 0, 0);
+		double length = myOrbitAxis.length();
+		myTurnAxis = (length != 0) ? myOrbitAxis / length : Vector3();
+	}
+	
 	void transform()
 	{
-		glRotated(myOrbitTilt, 1, 0, 0);
-		glRotated(myOrbitAngle, myOrbitAxis.x, myOrbitAxis.y, myOrbitAxis.z);
+		myOrbitFrame.apply();
+		glRotated(myMotion->orbitAngle, myOrbitAxis.x, myOrbitAxis.y, myOrbitAxis.z);
 		glTranslated(myDistance, 0, 0);
 		glColor3d(SUN_COLOR.r, SUN_COLOR.g, SUN_COLOR.b);
 	}
 	
-	void animate()
+	Affine localTransform(double orbitSine, double orbitCosine)
 	{
-		myRotationAngle += myRotationSpeed;
-		
-	    vector<SpaceObject*>::iterator it;
-        for(it = mySatellites->begin(); it < mySatellites->end(); it++)
-		{
-			(*it)->animate();
-		}
+		// turns about its orbit axis rather than y
+		Affine local = myOrbitFrame *
+		               Affine::unitRotation(orbitSine, orbitCosine, myTurnAxis.x, myTurnAxis.y, myTurnAxis.z);
+		local.translate(myDistance, 0, 0);
+		return local;
+	}
+	
+	void advance()
+	{
+		myMotion->rotationAngle = wrapDegrees(myMotion->rotationAngle + myRotationSpeed);
+	}
+	
+	// a sun turns in place, but never orbits
+	double getOrbitSpeed()
+	{
+		return 0;
 	}
 
-	string getParentName() 
+	const string& getParentName() 
 	{
-		return "";
+		static const string NONE;
+		return NONE;
 	}
 	
 	void colorObject()
 	{
 		glColor3d(SUN_COLOR.r, SUN_COLOR.g, SUN_COLOR.b);
 	}
+	
+	BodyKind getKind()
+	{
+		return KIND_SUN;
+	}
+	
+	Color getColor()
+	{
+		return SUN_COLOR;
+	}
 };
 
 const Color Planet::PLANET_COLOR(0.1, 0.1, 1);
@@ -0,0 +1,420 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a renderer that draws every body as a splat on
+// the CPU instead of as a sphere through OpenGL, for overview shots
+// of catalogs far too large to draw as meshes.
+//
+// Each frame runs on a group of threads in two steps:
+//   - every thread projects its share of the bodies' world positions
+//     (from SolarSystem::getState()) and bins them by screen tile;
+//   - every thread then takes whole tiles, so no two threads ever
+//     write the same pixel, and rasterizes the splats binned there.
+// Bodies at least a pixel across are drawn as opaque discs that
+// write depth; smaller ones add their brightness to a pixel if no
+// disc is in front of them, so dense regions glow.  Depth is the
+// distance along the view direction, so nothing is clipped by the
+// far plane.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef SPLAT_RENDERER_H_
+#define SPLAT_RENDERER_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "cglx.h"
+#include "solar_system.h"
+#include "body_state.h"
+#include "frame_barrier.h"
+#include "geometry.h"
+#include "memory_report.h"
+#include "trace.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class SplatRenderer
+{
+  private:
+    // one projected body, in pixels
+    struct Splat
+    {
+        float x, y;
+        float depth;
+        float radius;
+        uint32_t body;
+    };
+
+    int myWidth, myHeight;
+    int myTilesX, myTilesY;
+    // RGB brightness and depth of each pixel
+    vector<float> myColor;
+    vector<float> myDepth;
+    // the finished frame as RGBA rows, bottom row first
+    vector<unsigned char> myImage;
+    // RGB color and radius of each body
+    vector<float> myBodyColors;
+    vector<float> myRadii;
+    // splats binned by [thread][tile]
+    vector< vector< vector<Splat> > > myBins;
+
+    // the frame being rendered
+    const BodyState * myState;
+    double myMatrix[16];
+    double myFocalLength;
+
+    int myNumThreads;
+    vector<thread> myWorkers;
+    FrameBarrier myBarrier;
+    atomic<int> myNextTile;
+    bool isStopping;
+    ImageQuad myQuad;
+
+    void runWorker (int worker)
+    {
+        while (true)
+        {
+            // wait for a frame
+            myBarrier.wait();
+            if (isStopping)
+            {
+                break;
+            }
+            renderPart(worker);
+        }
+    }
+
+    /*
+     * One thread's share of a frame.
+     */
+    void renderPart (int worker)
+    {
+        project(worker);
+        // all splats must be binned before any tile is drawn
+        myBarrier.wait();
+        int numTiles = myTilesX * myTilesY;
+        int tile;
+        while ((tile = myNextTile++) < numTiles)
+        {
+            rasterize(tile);
+        }
+        myBarrier.wait();
+    }
+
+    void project (int worker)
+    {
+        TRACE_SCOPE("SplatRenderer::project");
+        vector< vector<Splat> >& bins = myBins[worker];
+        for (size_t k = 0; k < bins.size(); k++)
+        {
+            bins[k].clear();
+        }
+        const BodyState& state = *myState;
+        int count = min(state.size(), int(myRadii.size()));
+        int first = int(int64_t(count) * worker / myNumThreads);
+        int last = int(int64_t(count) * (worker + 1) / myNumThreads);
+        const double * m = myMatrix;
+        for (int b = first; b < last; b++)
+        {
+            double x = state.x[b], y = state.y[b], z = state.z[b];
+            double w = m[3] * x + m[7] * y + m[11] * z + m[15];
+            if (w <= MIN_DEPTH)
+            {
+                continue;
+            }
+            Splat s;
+            s.radius = float(myRadii[b] * myFocalLength / w);
+            s.x = float(((m[0] * x + m[4] * y + m[8] * z + m[12]) / w * 0.5 + 0.5) * myWidth);
+            s.y = float(((m[1] * x + m[5] * y + m[9] * z + m[13]) / w * 0.5 + 0.5) * myHeight);
+            if (s.x + s.radius < 0 || s.x - s.radius >= myWidth ||
+                s.y + s.radius < 0 || s.y - s.radius >= myHeight)
+            {
+                continue;
+            }
+            if (s.radius < 1 && (s.x < 0 || s.y < 0))
+            {
+                continue;
+            }
+            s.depth = float(w);
+            s.body = b;
+            int r = int(s.radius >= 1 ? s.radius : 0);
+            int tx0 = max(0, int(s.x) - r) / TILE_SIZE;
+            int tx1 = min(myWidth - 1, int(s.x) + r) / TILE_SIZE;
+            int ty0 = max(0, int(s.y) - r) / TILE_SIZE;
+            int ty1 = min(myHeight - 1, int(s.y) + r) / TILE_SIZE;
+            for (int ty = ty0; ty <= ty1; ty++)
+            {
+                for (int tx = tx0; tx <= tx1; tx++)
+                {
+                    bins[ty * myTilesX + tx].push_back(s);
+                }
+            }
+        }
+    }
+
+    void rasterize (int tile)
+    {
+        int x0 = (tile % myTilesX) * TILE_SIZE, y0 = (tile / myTilesX) * TILE_SIZE;
+        int x1 = min(x0 + TILE_SIZE, myWidth), y1 = min(y0 + TILE_SIZE, myHeight);
+        for (int y = y0; y < y1; y++)
+        {
+            fill(&myDepth[size_t(y) * myWidth + x0], &myDepth[size_t(y) * myWidth + x1], HUGE_VALF);
+            fill(&myColor[(size_t(y) * myWidth + x0) * 3], &myColor[(size_t(y) * myWidth + x1) * 3], 0.0f);
+        }
+
+        // opaque discs first, so points behind them can be rejected
+        for (int t = 0; t < myNumThreads; t++)
+        {
+            const vector<Splat>& bin = myBins[t][tile];
+            for (size_t k = 0; k < bin.size(); k++)
+            {
+                const Splat& s = bin[k];
+                if (s.radius < 1)
+                {
+                    continue;
+                }
+                const float * color = &myBodyColors[3 * s.body];
+                int sx0 = max(x0, int(floorf(s.x - s.radius))), sx1 = min(x1 - 1, int(s.x + s.radius));
+                int sy0 = max(y0, int(floorf(s.y - s.radius))), sy1 = min(y1 - 1, int(s.y + s.radius));
+                float r2 = s.radius * s.radius;
+                for (int y = sy0; y <= sy1; y++)
+                {
+                    float dy = y + 0.5f - s.y;
+                    for (int x = sx0; x <= sx1; x++)
+                    {
+                        float dx = x + 0.5f - s.x;
+                        size_t p = size_t(y) * myWidth + x;
+                        if (dx * dx + dy * dy <= r2 && s.depth < myDepth[p])
+                        {
+                            myDepth[p] = s.depth;
+                            myColor[3 * p] = color[0];
+                            myColor[3 * p + 1] = color[1];
+                            myColor[3 * p + 2] = color[2];
+                        }
+                    }
+                }
+            }
+        }
+        for (int t = 0; t < myNumThreads; t++)
+        {
+            const vector<Splat>& bin = myBins[t][tile];
+            for (size_t k = 0; k < bin.size(); k++)
+            {
+                const Splat& s = bin[k];
+                if (s.radius >= 1)
+                {
+                    continue;
+                }
+                size_t p = size_t(s.y) * myWidth + size_t(s.x);
+                if (s.depth < myDepth[p])
+                {
+                    // brightness by covered area, but never invisible
+                    float brightness = max(MIN_POINT_BRIGHTNESS, float(M_PI) * s.radius * s.radius);
+                    const float * color = &myBodyColors[3 * s.body];
+                    myColor[3 * p] += brightness * color[0];
+                    myColor[3 * p + 1] += brightness * color[1];
+                    myColor[3 * p + 2] += brightness * color[2];
+                }
+            }
+        }
+
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = x0; x < x1; x++)
+            {
+                size_t p = size_t(y) * myWidth + x;
+                for (int c = 0; c < 3; c++)
+                {
+                    myImage[4 * p + c] = (unsigned char)(min(myColor[3 * p + c], 1.0f) * 255 + 0.5f);
+                }
+                myImage[4 * p + 3] = 255;
+            }
+        }
+    }
+
+  public:
+    // pixels on each side of a tile
+    static const int TILE_SIZE = 64;
+    // splats each tile's bin holds before it first grows
+    static const int MIN_BIN_CAPACITY = 64;
+    // brightness of a body much smaller than a pixel
+    static constexpr float MIN_POINT_BRIGHTNESS = 0.35f;
+    // bodies closer than this to the eye are not drawn
+    static constexpr double MIN_DEPTH = 1e-3;
+
+
+    /*
+     * Uses the given number of threads (including the caller), or one
+     * per core if numThreads is 0.
+     */
+    SplatRenderer (int numThreads = 0)
+      : myWidth(0),
+        myHeight(0),
+        myTilesX(0),
+        myTilesY(0),
+        myState(NULL),
+        myFocalLength(1),
+        myNumThreads(numThreads > 0 ? numThreads : max(1, int(thread::hardware_concurrency()))),
+        myNextTile(0),
+        isStopping(false)
+    {
+        myBins.resize(myNumThreads);
+        myBarrier.reset(myNumThreads);
+        for (int k = 1; k < myNumThreads; k++)
+        {
+            myWorkers.push_back(thread(&SplatRenderer::runWorker, this, k));
+        }
+    }
+
+
+    ~SplatRenderer ()
+    {
+        isStopping = true;
+        myBarrier.wait();
+        for (size_t k = 0; k < myWorkers.size(); k++)
+        {
+            myWorkers[k].join();
+        }
+    }
+
+
+    /*
+     * Caches each body's color and size; call again if the catalog
+     * changes.
+     */
+    void setBodies (SolarSystem * system)
+    {
+        int count = system->getBodyCount();
+        myBodyColors.resize(3 * count);
+        myRadii.resize(count);
+        for (int k = 0; k < count; k++)
+        {
+            SpaceObject * body = system->getBody(k);
+            Color color = body->getColor();
+            // clamped as glColor3d clamps
+            myBodyColors[3 * k] = float(max(0.0, min(color.r, 1.0)));
+            myBodyColors[3 * k + 1] = float(max(0.0, min(color.g, 1.0)));
+            myBodyColors[3 * k + 2] = float(max(0.0, min(color.b, 1.0)));
+            myRadii[k] = float(body->getSize());
+        }
+    }
+
+
+    /*
+     * Renders the world positions in state, as seen through the given
+     * OpenGL-style (column-major) modelview and projection matrices,
+     * into a width x height image.
+     */
+    void render (const BodyState& state, const double modelview[16],
+                 const double projection[16], int width, int height)
+    {
+        TRACE_SCOPE("SplatRenderer::render");
+        if (width != myWidth || height != myHeight)
+        {
+            myWidth = width;
+            myHeight = height;
+            myTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+            myTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+            myColor.assign(size_t(width) * height * 3, 0);
+            myDepth.assign(size_t(width) * height, 0);
+            myImage.assign(size_t(width) * height * 4, 0);
+            for (int t = 0; t < myNumThreads; t++)
+            {
+                myBins[t].resize(myTilesX * myTilesY);
+                // room up front, so bodies moving between tiles rarely grow a bin
+                for (size_t b = 0; b < myBins[t].size(); b++)
+                {
+                    myBins[t][b].reserve(MIN_BIN_CAPACITY);
+                }
+            }
+        }
+        for (int r = 0; r < 4; r++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                double sum = 0;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += projection[k * 4 + r] * modelview[c * 4 + k];
+                }
+                myMatrix[c * 4 + r] = sum;
+            }
+        }
+        // pixels per unit of size at unit depth
+        myFocalLength = projection[5] * height / 2;
+        myState = &state;
+        myNextTile = 0;
+
+        // start the other threads and do a share of the work here too
+        myBarrier.wait();
+        renderPart(0);
+    }
+
+
+    /*
+     * Draws the last image stretched over the current viewport.
+     */
+    void present ()
+    {
+        myQuad.draw(myWidth, myHeight, &myImage[0]);
+    }
+
+
+    /*
+     * Adds the pixel, body and bin buffers to report, under "splats".
+     */
+    void reportMemory (MemoryReport& report) const
+    {
+        size_t bytes = MemoryReport::bytesOf(myColor) + MemoryReport::bytesOf(myDepth) +
+                       MemoryReport::bytesOf(myImage) + MemoryReport::bytesOf(myBodyColors) +
+                       MemoryReport::bytesOf(myRadii) + MemoryReport::bytesOf(myBins);
+        long bins = 0;
+        for (size_t t = 0; t < myBins.size(); t++)
+        {
+            bytes += MemoryReport::bytesOf(myBins[t]);
+            for (size_t b = 0; b < myBins[t].size(); b++)
+            {
+                bytes += MemoryReport::bytesOf(myBins[t][b]);
+            }
+            bins += long(myBins[t].size());
+        }
+        report.add("splats", bytes, bins);
+    }
+
+
+    int getWidth () const
+    {
+        return myWidth;
+    }
+
+
+    int getHeight () const
+    {
+        return myHeight;
+    }
+
+
+    int getNumThreads () const
+    {
+        return myNumThreads;
+    }
+
+
+    /*
+     * Returns the last image as RGBA rows, bottom row first.
+     */
+    const unsigned char * getImage () const
+    {
+        return &myImage[0];
+    }
+};
+
+#endif
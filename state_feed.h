@@ -0,0 +1,183 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines the publisher of the shared memory state feed
+// described in solar_feed.h.  Publishing a tick copies the state
+// arrays into the next slot of the ring; readers map the memory
+// themselves, so the cost does not depend on how many there are.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef STATE_FEED_H_
+#define STATE_FEED_H_
+
+#include <cstring>           // for memcpy
+#include <string>
+#include <algorithm>         // for min
+#include "solar_feed.h"
+#include "body_state.h"
+#include "memory_report.h"
+#include "trace.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class StateFeed
+{
+  private:
+    string myName;
+    solar_feed_header * myHeader;
+    size_t mySize;
+
+    char * getSlot (uint64_t index)
+    {
+        return (char *)myHeader + myHeader->slot_offset + index * myHeader->slot_size;
+    }
+
+    template <class T>
+    void copyArray (char * slot, int array, const vector<T>& values, uint32_t count)
+    {
+        memcpy(slot + solar_feed_array_offset(myHeader->capacity, array), &values[0],
+               count * sizeof(T));
+    }
+
+  public:
+    // ticks kept in the ring, so slow readers can still finish a tick
+    static const uint32_t NUM_SLOTS = 4;
+
+
+    StateFeed ()
+      : myHeader(NULL),
+        mySize(0)
+    {
+    }
+
+
+    ~StateFeed ()
+    {
+        close();
+    }
+
+
+    /*
+     * Creates (or replaces) the feed with the given name, e.g.
+     * "/solarsystem", for up to capacity bodies.
+     *
+     * Returns false if the shared memory could not be created.
+     */
+    bool create (const string& name, uint32_t capacity)
+    {
+        close();
+        size_t slotOffset = solar_feed_round(sizeof(solar_feed_header));
+        size_t slotSize = solar_feed_slot_size(capacity);
+        mySize = slotOffset + NUM_SLOTS * slotSize;
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        void * memory = MAP_FAILED;
+        if (ftruncate(fd, mySize) == 0)
+        {
+            memory = mmap(NULL, mySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+            shm_unlink(name.c_str());
+            return false;
+        }
+        myName = name;
+        myHeader = (solar_feed_header *)memory;
+        myHeader->capacity = capacity;
+        myHeader->num_slots = NUM_SLOTS;
+        myHeader->slot_offset = slotOffset;
+        myHeader->slot_size = slotSize;
+        myHeader->latest = 0;
+        myHeader->version = SOLAR_FEED_VERSION;
+        // readers check the magic last
+        __atomic_store_n(&myHeader->magic, SOLAR_FEED_MAGIC, __ATOMIC_RELEASE);
+        return true;
+    }
+
+
+    /*
+     * Removes the feed; readers that have it mapped keep their copy.
+     */
+    void close ()
+    {
+        if (myHeader != NULL)
+        {
+            munmap(myHeader, mySize);
+            shm_unlink(myName.c_str());
+            myHeader = NULL;
+        }
+    }
+
+
+    bool isOpen () const
+    {
+        return myHeader != NULL;
+    }
+
+
+    /*
+     * Adds the shared memory mapped for the ring, if open, to report,
+     * under "state feed".
+     */
+    void reportMemory (MemoryReport& report) const
+    {
+        if (isOpen())
+        {
+            report.add("state feed", mySize, NUM_SLOTS);
+        }
+    }
+
+
+    uint32_t getCapacity () const
+    {
+        return (myHeader == NULL) ? 0 : myHeader->capacity;
+    }
+
+
+    /*
+     * Copies state into the next slot and makes it the newest tick.
+     * Bodies beyond the feed's capacity are left out.
+     */
+    void publish (const BodyState& state)
+    {
+        TRACE_SCOPE("StateFeed::publish");
+        if (myHeader == NULL)
+        {
+            return;
+        }
+        uint64_t latest = myHeader->latest;
+        char * base = getSlot(latest % myHeader->num_slots);
+        solar_feed_slot * slot = (solar_feed_slot *)base;
+        uint32_t count = min(uint32_t(state.size()), myHeader->capacity);
+
+        // odd sequence: readers of this slot will retry
+        uint64_t sequence = slot->sequence;
+        __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->tick = state.tick;
+        slot->count = count;
+        if (count > 0)
+        {
+            copyArray(base, SOLAR_FEED_IDS, state.ids, count);
+            copyArray(base, SOLAR_FEED_X, state.x, count);
+            copyArray(base, SOLAR_FEED_Y, state.y, count);
+            copyArray(base, SOLAR_FEED_Z, state.z, count);
+            copyArray(base, SOLAR_FEED_ORBIT_ANGLES, state.orbitAngles, count);
+            copyArray(base, SOLAR_FEED_ROTATION_ANGLES, state.rotationAngles, count);
+        }
+        __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+        __atomic_store_n(&myHeader->latest, latest + 1, __ATOMIC_RELEASE);
+    }
+};
+
+#endif
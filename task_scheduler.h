@@ -0,0 +1,501 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines one pool of worker threads for the whole program,
+// so features split their work into tasks instead of each starting
+// threads of their own.
+//
+// Each worker (and any thread waiting on tasks) keeps its own deque:
+// it pushes and pops tasks at the back, newest first, while idle
+// workers steal the oldest from the front of others' deques.  A
+// parallel loop is queued as one range that is halved again and again
+// as it runs, so a thief always takes the biggest piece left, and the
+// loop never needs more than a few queued tasks per thread.  Nothing
+// is allocated once the workers have started, so a steady-state frame
+// can use the pool without allocating (see alloc_counter.h).
+//
+// Workers can be pinned to cores, taking the cores of one NUMA node
+// before the next, so neighbouring workers, which steal from each
+// other first, share a node's memory.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef TASK_SCHEDULER_H_
+#define TASK_SCHEDULER_H_
+
+#include <pthread.h>         // for pthread_setaffinity_np
+#include <sched.h>           // for cpu_set_t
+#include <cstdio>            // for fopen, snprintf
+#include <vector>
+#include <memory>            // for unique_ptr
+#include <algorithm>         // for max
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+
+class TaskScheduler;
+class TaskGroup;
+
+/*
+ * One queued piece of work: items [begin, end) of a caller's loop,
+ * or a whole task (begin == end).
+ */
+struct Task
+{
+    void (*run)(TaskScheduler& scheduler, const Task& task);
+    const void * work;
+    int begin, end;
+    int grain;
+    TaskGroup * group;
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class TaskScheduler
+{
+  public:
+    // tasks each deque holds; more are run by whoever queued them
+    static const int QUEUE_CAPACITY = 1024;
+    // times an idle worker looks for work before it sleeps
+    static const int IDLE_SPINS = 64;
+
+
+    TaskScheduler ()
+      : myNumThreads(1),
+        isPinned(false),
+        isStopping(false),
+        myNumQueued(0),
+        myNumSleeping(0)
+    {
+        myQueues.push_back(unique_ptr<Queue>(new Queue()));
+    }
+
+
+    ~TaskScheduler ()
+    {
+        stop();
+    }
+
+
+    /*
+     * Starts workers so that numThreads threads, including each caller
+     * waiting on tasks, share the work, or one per core if numThreads
+     * is 0.  Pins the workers to cores if asked.
+     */
+    void start (int numThreads = 0, bool pinned = false)
+    {
+        stop();
+        myNumThreads = (numThreads > 0) ? numThreads : max(1, int(thread::hardware_concurrency()));
+        isPinned = pinned;
+        isStopping = false;
+        myQueues.clear();
+        for (int k = 0; k < myNumThreads; k++)
+        {
+            myQueues.push_back(unique_ptr<Queue>(new Queue()));
+        }
+        vector<int> cores = isPinned ? getCoresByNode() : vector<int>();
+        for (int k = 1; k < myNumThreads; k++)
+        {
+            myWorkers.push_back(thread(&TaskScheduler::runWorker, this, k));
+            if (! cores.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cores[k % cores.size()], &set);
+                pthread_setaffinity_np(myWorkers.back().native_handle(), sizeof(set), &set);
+            }
+        }
+    }
+
+
+    /*
+     * Stops and joins the workers, leaving only callers to run tasks.
+     */
+    void stop ()
+    {
+        {
+            lock_guard<mutex> guard(mySleepLock);
+            isStopping = true;
+        }
+        myWake.notify_all();
+        for (size_t k = 0; k < myWorkers.size(); k++)
+        {
+            myWorkers[k].join();
+        }
+        myWorkers.clear();
+        myNumThreads = 1;
+    }
+
+
+    int getNumThreads () const
+    {
+        return myNumThreads;
+    }
+
+
+    bool isPinning () const
+    {
+        return isPinned;
+    }
+
+
+    /*
+     * Calls body(first, last) over [begin, end) split into ranges of
+     * at most grain items, across the workers, and returns once every
+     * range is done.  Runs in the caller alone if there are no workers
+     * or too few items to split.
+     */
+    template <typename F>
+    void parallelFor (int begin, int end, int grain, const F& body);
+
+
+  private:
+    friend class TaskGroup;
+
+    // a worker's tasks, newest at the back
+    struct alignas(64) Queue
+    {
+        mutex lock;
+        Task tasks[QUEUE_CAPACITY];
+        // positions of the oldest and one past the newest, never wrapped
+        long front, back;
+
+        Queue ()
+          : front(0),
+            back(0)
+        {
+        }
+    };
+
+    // the scheduler this thread works for, and its deque there
+    struct WorkerSlot
+    {
+        TaskScheduler * scheduler;
+        int index;
+    };
+
+    vector< unique_ptr<Queue> > myQueues;
+    vector<thread> myWorkers;
+    int myNumThreads;
+    bool isPinned;
+    bool isStopping;
+    atomic<int> myNumQueued;
+    atomic<int> myNumSleeping;
+    mutex mySleepLock;
+    condition_variable myWake;
+
+
+    static WorkerSlot& getSlot ()
+    {
+        thread_local WorkerSlot slot = { NULL, 0 };
+        return slot;
+    }
+
+
+    /*
+     * Returns this thread's deque: its own if a worker, else the first,
+     * which every other caller shares.
+     */
+    int getQueueIndex ()
+    {
+        WorkerSlot& slot = getSlot();
+        return (slot.scheduler == this) ? slot.index : 0;
+    }
+
+
+    /*
+     * Queues task on this thread's deque, or returns false if full.
+     */
+    bool push (const Task& task)
+    {
+        Queue& queue = *myQueues[getQueueIndex()];
+        {
+            lock_guard<mutex> guard(queue.lock);
+            if (queue.back - queue.front >= QUEUE_CAPACITY)
+            {
+                return false;
+            }
+            queue.tasks[queue.back % QUEUE_CAPACITY] = task;
+            queue.back++;
+        }
+        myNumQueued++;
+        if (myNumSleeping > 0)
+        {
+            lock_guard<mutex> guard(mySleepLock);
+            myWake.notify_one();
+        }
+        return true;
+    }
+
+
+    /*
+     * Takes the newest task from this thread's deque or else the oldest
+     * from another's, starting with the next one along.
+     */
+    bool findTask (Task& task)
+    {
+        int index = getQueueIndex();
+        int count = int(myQueues.size());
+        for (int k = 0; k < count; k++)
+        {
+            Queue& queue = *myQueues[(index + k) % count];
+            lock_guard<mutex> guard(queue.lock);
+            if (queue.back > queue.front)
+            {
+                if (k == 0)
+                {
+                    queue.back--;
+                    task = queue.tasks[queue.back % QUEUE_CAPACITY];
+                }
+                else
+                {
+                    task = queue.tasks[queue.front % QUEUE_CAPACITY];
+                    queue.front++;
+                }
+                myNumQueued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    void execute (const Task& task);
+
+
+    void runWorker (int index)
+    {
+        WorkerSlot& slot = getSlot();
+        slot.scheduler = this;
+        slot.index = index;
+        while (true)
+        {
+            Task task;
+            if (findTask(task))
+            {
+                execute(task);
+                continue;
+            }
+            bool isQueued = false;
+            for (int k = 0; k < IDLE_SPINS && ! isQueued; k++)
+            {
+                this_thread::yield();
+                isQueued = myNumQueued > 0;
+            }
+            if (isQueued)
+            {
+                continue;
+            }
+            // push() checks for sleepers after queuing, so none is missed
+            unique_lock<mutex> guard(mySleepLock);
+            myNumSleeping++;
+            while (! isStopping && myNumQueued == 0)
+            {
+                myWake.wait(guard);
+            }
+            myNumSleeping--;
+            if (isStopping)
+            {
+                return;
+            }
+        }
+    }
+
+
+    /*
+     * Returns every core, those of NUMA node 0 first, then node 1, ...,
+     * or every core in order if the nodes cannot be read.
+     */
+    static vector<int> getCoresByNode ()
+    {
+        vector<int> cores;
+        for (int node = 0; ; node++)
+        {
+            char fileName[128];
+            snprintf(fileName, sizeof(fileName), "/sys/devices/system/node/node%d/cpulist", node);
+            FILE * in = fopen(fileName, "r");
+            if (in == NULL)
+            {
+                break;
+            }
+            // ranges such as "0-3,8-11"
+            int first, last;
+            while (fscanf(in, "%d", &first) == 1)
+            {
+                last = first;
+                if (fscanf(in, "-%d", &last) != 1)
+                {
+                    last = first;
+                }
+                for (int core = first; core <= last; core++)
+                {
+                    cores.push_back(core);
+                }
+                if (fgetc(in) != ',')
+                {
+                    break;
+                }
+            }
+            fclose(in);
+        }
+        if (cores.empty())
+        {
+            for (int core = 0; core < int(thread::hardware_concurrency()); core++)
+            {
+                cores.push_back(core);
+            }
+        }
+        return cores;
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+/*
+ * Tasks queued together and waited on together.  Work given to run()
+ * or parallelFor() is referred to, not copied, so it must outlive
+ * wait(); the destructor waits too.
+ */
+class TaskGroup
+{
+  private:
+    TaskScheduler& myScheduler;
+    atomic<int> myPending;
+
+    friend class TaskScheduler;
+
+    template <typename F>
+    static void runWhole (TaskScheduler&, const Task& task)
+    {
+        (*static_cast<const F *>(task.work))();
+    }
+
+
+    /*
+     * Queues the top half of the range until what is left is at most
+     * grain items, then runs that.
+     */
+    template <typename F>
+    static void runRange (TaskScheduler&, const Task& task)
+    {
+        int end = task.end;
+        while (end - task.begin > task.grain)
+        {
+            int middle = task.begin + (end - task.begin) / 2;
+            Task upper = task;
+            upper.begin = middle;
+            upper.end = end;
+            task.group->queue(upper);
+            end = middle;
+        }
+        (*static_cast<const F *>(task.work))(task.begin, end);
+    }
+
+
+    /*
+     * Queues the task, or runs it here if this thread's deque is full.
+     */
+    void queue (const Task& task)
+    {
+        myPending++;
+        if (! myScheduler.push(task))
+        {
+            myScheduler.execute(task);
+        }
+    }
+
+  public:
+    TaskGroup (TaskScheduler& scheduler)
+      : myScheduler(scheduler),
+        myPending(0)
+    {
+    }
+
+
+    ~TaskGroup ()
+    {
+        wait();
+    }
+
+
+    /*
+     * Queues work() to run on some thread.
+     */
+    template <typename F>
+    void run (const F& work)
+    {
+        Task task = { &TaskGroup::runWhole<F>, &work, 0, 0, 0, this };
+        queue(task);
+    }
+
+
+    /*
+     * Queues body(first, last) over [begin, end), split into ranges of
+     * at most grain items as threads become free to take them.
+     */
+    template <typename F>
+    void parallelFor (int begin, int end, int grain, const F& body)
+    {
+        if (begin < end)
+        {
+            Task task = { &TaskGroup::runRange<F>, &body, begin, end, max(1, grain), this };
+            queue(task);
+        }
+    }
+
+
+    /*
+     * Runs queued tasks, this group's or others', until every task of
+     * this group is done.
+     */
+    void wait ()
+    {
+        while (myPending > 0)
+        {
+            Task task;
+            if (myScheduler.findTask(task))
+            {
+                myScheduler.execute(task);
+            }
+            else
+            {
+                this_thread::yield();
+            }
+        }
+    }
+};
+
+
+inline void TaskScheduler::execute (const Task& task)
+{
+    TaskGroup * group = task.group;
+    task.run(*this, task);
+    group->myPending--;
+}
+
+
+template <typename F>
+void TaskScheduler::parallelFor (int begin, int end, int grain, const F& body)
+{
+    if (myNumThreads <= 1 || end - begin <= grain)
+    {
+        if (begin < end)
+        {
+            body(begin, end);
+        }
+        return;
+    }
+    TaskGroup group(*this);
+    group.parallelFor(begin, end, grain, body);
+    group.wait();
+}
+
+#endif
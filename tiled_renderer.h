@@ -0,0 +1,234 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines a renderer that splits a monitor wall's view
+// into a grid of tiles and renders each tile on its own thread,
+// into its own offscreen context, using an off-axis slice of the
+// wall's frustum.  A frame barrier makes all tiles draw the same
+// simulation state and finish before the wall image is presented,
+// so a wall-sized image can be produced on a single host.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef TILED_RENDERER_H_
+#define TILED_RENDERER_H_
+
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include "cglx.h"
+#include "offscreen.h"
+#include "frustum.h"
+#include "frame_barrier.h"
+#include "geometry.h"
+#include "scene.h"
+#include "trace.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class TiledRenderer
+{
+  private:
+    Scene * myScene;
+    Frustum myWall;
+    int myCols, myRows;
+    int myTileWidth, myTileHeight;
+    // the whole wall as RGBA rows, bottom row first
+    vector<unsigned char> myImage;
+    vector<thread> myWorkers;
+    FrameBarrier myBarrier;
+    bool isStopping;
+    int myNumFailed;
+    mutex myFailedLock;
+    ImageQuad myQuad;
+
+    /*
+     * Body of each tile's thread: owns one offscreen context and
+     * renders its tile between the start and end of every frame.
+     */
+    void renderTiles (int tile)
+    {
+        int col = tile % myCols, row = tile / myCols;
+        OffscreenContext context;
+        bool ok = context.create(myTileWidth, myTileHeight);
+        if (! ok)
+        {
+            lock_guard<mutex> guard(myFailedLock);
+            myNumFailed++;
+        }
+        else
+        {
+            glClearColor(0, 0, 0, 0);
+            glEnable(GL_DEPTH_TEST);
+            if (myWall.isReversed)
+            {
+                Frustum::enableReversedDepth();
+            }
+        }
+        Frustum frustum = myWall.tile(col, row, myCols, myRows);
+        // report initialization
+        myBarrier.wait();
+
+        while (true)
+        {
+            // wait for the frame to start
+            myBarrier.wait();
+            if (isStopping)
+            {
+                break;
+            }
+            if (ok)
+            {
+                TRACE_SCOPE("TiledRenderer::tile");
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glMatrixMode(GL_PROJECTION);
+                glLoadIdentity();
+                frustum.apply();
+                glMatrixMode(GL_MODELVIEW);
+                glLoadIdentity();
+                myScene->setCamera();
+                myScene->cull();
+                myScene->display();
+                // copy straight into this tile's part of the wall image
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                glPixelStorei(GL_PACK_ROW_LENGTH, getWidth());
+                glReadPixels(0, 0, myTileWidth, myTileHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                             &myImage[(size_t(row) * myTileHeight * getWidth() +
+                                       size_t(col) * myTileWidth) * 4]);
+            }
+            // wait for the other tiles to finish
+            myBarrier.wait();
+        }
+    }
+
+  public:
+    TiledRenderer (Scene * scene)
+      : myScene(scene),
+        myCols(0),
+        myRows(0),
+        myTileWidth(0),
+        myTileHeight(0),
+        isStopping(false),
+        myNumFailed(0)
+    {
+    }
+
+
+    ~TiledRenderer ()
+    {
+        stop();
+    }
+
+
+    /*
+     * Starts one thread per tile of a cols x rows wall, where each
+     * tile is tileWidth x tileHeight pixels and the whole wall is
+     * seen through the given frustum.
+     *
+     * Returns false (with no threads left running) if any tile could
+     * not create its context.
+     */
+    bool start (int cols, int rows, int tileWidth, int tileHeight, const Frustum& wall)
+    {
+        stop();
+        myCols = cols;
+        myRows = rows;
+        myTileWidth = tileWidth;
+        myTileHeight = tileHeight;
+        myWall = wall;
+        myImage.assign(size_t(getWidth()) * getHeight() * 4, 0);
+        isStopping = false;
+        myNumFailed = 0;
+        myBarrier.reset(cols * rows + 1);
+        for (int k = 0; k < cols * rows; k++)
+        {
+            myWorkers.push_back(thread(&TiledRenderer::renderTiles, this, k));
+        }
+        myBarrier.wait();
+        if (myNumFailed > 0)
+        {
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+
+    /*
+     * Stops and joins all tile threads.
+     */
+    void stop ()
+    {
+        if (myWorkers.empty())
+        {
+            return;
+        }
+        isStopping = true;
+        myBarrier.wait();
+        for (size_t k = 0; k < myWorkers.size(); k++)
+        {
+            myWorkers[k].join();
+        }
+        myWorkers.clear();
+    }
+
+
+    bool isRunning () const
+    {
+        return ! myWorkers.empty();
+    }
+
+
+    /*
+     * Renders all tiles of one frame and waits for them to finish.
+     *
+     * The scene must not be updated while this runs.  Every body's
+     * world position is found first, on the calling thread (and the
+     * scheduler's), so the tiles only read them: no tile thread waits
+     * on the world lock or runs the scheduler's tasks.
+     */
+    void renderFrame ()
+    {
+        TRACE_SCOPE("TiledRenderer::renderFrame");
+        myScene->getSolarSystem()->getState();
+        myBarrier.wait();
+        myBarrier.wait();
+    }
+
+
+    /*
+     * Draws the wall image scaled to fill the current viewport.
+     */
+    void present ()
+    {
+        myQuad.draw(getWidth(), getHeight(), &myImage[0]);
+    }
+
+
+    int getWidth () const
+    {
+        return myCols * myTileWidth;
+    }
+
+
+    int getHeight () const
+    {
+        return myRows * myTileHeight;
+    }
+
+
+    /*
+     * Returns the last wall image as RGBA rows, bottom row first.
+     */
+    const unsigned char * getImage () const
+    {
+        return &myImage[0];
+    }
+};
+
+#endif
@@ -0,0 +1,227 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines lightweight scoped instrumentation spans that
+// can be exported in Chrome trace format (open the file with
+// chrome://tracing or Perfetto).
+//
+// Spans are only compiled in when DEF_USE_TRACE is defined (e.g.,
+// "make TRACE=1"); otherwise TRACE_SCOPE expands to nothing.
+//
+// Each thread appends to its own chain of fixed-size chunks, so
+// recording a span takes no locks: a chunk is only written by its
+// owning thread and events are published with a release store of
+// the chunk's count.  The only lock is taken once per thread, when
+// its buffer is registered for export.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#ifdef DEF_USE_TRACE
+
+#include <time.h>            // clock_gettime
+#include <cstdio>            // for fopen
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+ * One completed span; name must be a string literal.
+ */
+struct TraceEvent
+{
+    const char * name;
+    long long start;         // nanoseconds since trace epoch
+    long long duration;      // nanoseconds
+};
+
+
+/*
+ * Fixed-size block of events owned by a single thread.
+ */
+struct TraceChunk
+{
+    static const int CAPACITY = 4096;
+
+    TraceEvent events[CAPACITY];
+    std::atomic<int> count;
+    std::atomic<TraceChunk *> next;
+
+    TraceChunk () : count(0), next(NULL) {}
+};
+
+
+/*
+ * Per-thread list of chunks.
+ */
+struct TraceBuffer
+{
+    int threadId;
+    TraceChunk * first;
+    TraceChunk * last;
+
+    TraceBuffer (int id) : threadId(id)
+    {
+        first = last = new TraceChunk();
+    }
+
+    void append (const char * name, long long start, long long duration)
+    {
+        int n = last->count.load(std::memory_order_relaxed);
+        if (n == TraceChunk::CAPACITY)
+        {
+            TraceChunk * chunk = new TraceChunk();
+            last->next.store(chunk, std::memory_order_release);
+            last = chunk;
+            n = 0;
+        }
+        TraceEvent& e = last->events[n];
+        e.name = name;
+        e.start = start;
+        e.duration = duration;
+        last->count.store(n + 1, std::memory_order_release);
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class Trace
+{
+  private:
+    std::mutex myLock;
+    std::vector<TraceBuffer *> myBuffers;
+    long long myEpoch;
+
+    Trace () : myEpoch(0)
+    {
+        myEpoch = clockNanos();
+    }
+
+    static long long clockNanos ()
+    {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec * 1000000000LL + time.tv_nsec;
+    }
+
+    TraceBuffer * registerThread ()
+    {
+        std::lock_guard<std::mutex> guard(myLock);
+        TraceBuffer * buffer = new TraceBuffer(int(myBuffers.size()) + 1);
+        myBuffers.push_back(buffer);
+        return buffer;
+    }
+
+  public:
+    /*
+     * Returns the process-wide trace collector.
+     */
+    static Trace& instance ()
+    {
+        static Trace theTrace;
+        return theTrace;
+    }
+
+
+    /*
+     * Returns nanoseconds since the trace started.
+     */
+    long long now () const
+    {
+        return clockNanos() - myEpoch;
+    }
+
+
+    /*
+     * Returns the calling thread's buffer, registering it on first use.
+     */
+    TraceBuffer * threadBuffer ()
+    {
+        static thread_local TraceBuffer * theBuffer = NULL;
+        if (theBuffer == NULL)
+        {
+            theBuffer = registerThread();
+        }
+        return theBuffer;
+    }
+
+
+    /*
+     * Writes all spans recorded so far as Chrome trace JSON.
+     *
+     * Returns false if the file could not be written.
+     */
+    bool writeChromeJSON (const char * fileName)
+    {
+        FILE * out = fopen(fileName, "w");
+        if (out == NULL)
+        {
+            return false;
+        }
+        fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        bool first = true;
+        std::lock_guard<std::mutex> guard(myLock);
+        for (size_t b = 0; b < myBuffers.size(); b++)
+        {
+            TraceChunk * chunk = myBuffers[b]->first;
+            while (chunk != NULL)
+            {
+                int n = chunk->count.load(std::memory_order_acquire);
+                for (int k = 0; k < n; k++)
+                {
+                    const TraceEvent& e = chunk->events[k];
+                    fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"solar\",\"ph\":\"X\","
+                                 "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                            first ? "" : ",", e.name,
+                            e.start / 1000.0, e.duration / 1000.0,
+                            myBuffers[b]->threadId);
+                    first = false;
+                }
+                chunk = chunk->next.load(std::memory_order_acquire);
+            }
+        }
+        fprintf(out, "\n]}\n");
+        return fclose(out) == 0;
+    }
+};
+
+
+/*
+ * Records the lifetime of the enclosing scope as one span.
+ */
+class TraceSpan
+{
+  private:
+    const char * myName;
+    long long myStart;
+
+  public:
+    TraceSpan (const char * name)
+      : myName(name),
+        myStart(Trace::instance().now())
+    {
+    }
+
+    ~TraceSpan ()
+    {
+        Trace& trace = Trace::instance();
+        trace.threadBuffer()->append(myName, myStart, trace.now() - myStart);
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(theTraceSpan, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+
+#endif
+
+#endif
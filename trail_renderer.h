@@ -0,0 +1,473 @@
+//////////////////////////////////////////////////////////////////
+// A basic framework designed for a monitor wall using CGLX.
+//
+// This file defines trails showing where each body has been over
+// its last few ticks.  Every kind has a ring of recent positions,
+// stored one tick after another with all of the kind's bodies in
+// each, so a tick adds one contiguous slice per kind:
+//
+//     [tick t: body 0, body 1, ...][tick t + 1: body 0, ...] ...
+//
+// Each OpenGL context keeps the rings in one vertex buffer and only
+// copies in the slices added since it last drew.  A fixed index
+// buffer walks each body's ring twice over, so any window of a ring
+// is one contiguous run of indices, and every trail is drawn with a
+// single glMultiDrawElements() that only needs each trail's start.
+// Both adding a tick and drawing cost O(bodies), however long the
+// trails are.
+//
+// Positions are stored as floats relative to an origin near the eye,
+// which moves (with the whole ring re-sent once) only when the eye
+// wanders far from it, so trails far from the world origin stay
+// smooth.
+//
+//////////////////////////////////////////////////////////////////
+// Includes
+//
+#ifndef TRAIL_RENDERER_H_
+#define TRAIL_RENDERER_H_
+
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>         // for min, max
+#include "cglx.h"
+#include "solar_system.h"
+#include "body_state.h"
+#include "batch_renderer.h"
+#include "memory_report.h"
+#include "vector_math.h"
+#include "trace.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////
+// Class Declaration
+//
+class TrailRenderer
+{
+  private:
+    // one kind's ring, within the vertex and index buffers
+    struct Ring
+    {
+        vector<int> bodies;
+        // ticks kept
+        int length;
+        // first vertex and first index
+        size_t vertexOffset;
+        size_t indexOffset;
+    };
+
+    /*
+     * The buffers of one OpenGL context, which each drawing thread has.
+     */
+    struct Context
+    {
+        unsigned int generation;
+        GLuint buffers[3];
+        // ticks copied into the vertex buffer so far
+        uint64_t numCopied;
+        vector<GLsizei> counts;
+        vector<const GLvoid *> starts;
+
+
+        Context ()
+          : generation(0),
+            numCopied(0)
+        {
+            buffers[0] = buffers[1] = buffers[2] = 0;
+        }
+    };
+
+    Ring myRings[NUM_BODY_KINDS];
+    int myLengths[NUM_BODY_KINDS];
+    // positions as in the vertex buffer, relative to myOrigin, and each
+    // vertex's color
+    vector<GLfloat> myPositions;
+    double myOrigin[3];
+    vector<GLfloat> myColors;
+    size_t myNumVertices;
+    size_t myNumIndices;
+    // ticks added since the last reset
+    uint64_t myNumTicks;
+    // changes whenever the layout does, so contexts know to start over
+    unsigned int myGeneration;
+    bool isEnabled;
+
+    static unsigned int nextGeneration ()
+    {
+        static atomic<unsigned int> theGeneration(0);
+        return ++theGeneration;
+    }
+
+    /*
+     * Lays out the rings for the current catalog and lengths, and
+     * forgets every trail.
+     */
+    void layout ()
+    {
+        myNumVertices = 0;
+        myNumIndices = 0;
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            Ring& ring = myRings[kind];
+            ring.length = ring.bodies.empty() ? 0 : myLengths[kind];
+            ring.vertexOffset = myNumVertices;
+            ring.indexOffset = myNumIndices;
+            myNumVertices += size_t(ring.length) * ring.bodies.size();
+            myNumIndices += 2 * size_t(ring.length) * ring.bodies.size();
+        }
+        myPositions.assign(3 * myNumVertices, 0);
+        myColors.resize(3 * myNumVertices);
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            const Ring& ring = myRings[kind];
+            Color color = getKindColor(BodyKind(kind));
+            GLfloat rgb[3] = { GLfloat(max(0.0, min(color.r, 1.0)) * TRAIL_BRIGHTNESS),
+                               GLfloat(max(0.0, min(color.g, 1.0)) * TRAIL_BRIGHTNESS),
+                               GLfloat(max(0.0, min(color.b, 1.0)) * TRAIL_BRIGHTNESS) };
+            size_t first = ring.vertexOffset;
+            size_t last = first + size_t(ring.length) * ring.bodies.size();
+            for (size_t v = first; v < last; v++)
+            {
+                copy(rgb, rgb + 3, &myColors[3 * v]);
+            }
+        }
+        myNumTicks = 0;
+        myGeneration = nextGeneration();
+    }
+
+    static Color getKindColor (BodyKind kind)
+    {
+        switch (kind)
+        {
+          case KIND_SUN:
+            return KindTraits<KIND_SUN>::color();
+          case KIND_PLANET:
+            return KindTraits<KIND_PLANET>::color();
+          default:
+            return KindTraits<KIND_MOON>::color();
+        }
+    }
+
+    /*
+     * Moves the origin positions are stored relative to, adjusting
+     * every stored position, and has every context send them again.
+     */
+    void rebase (const Point3& origin)
+    {
+        double shift[3] = { myOrigin[0] - origin.x, myOrigin[1] - origin.y, myOrigin[2] - origin.z };
+        for (size_t k = 0; k < myPositions.size(); k++)
+        {
+            myPositions[k] = GLfloat(myPositions[k] + shift[k % 3]);
+        }
+        myOrigin[0] = origin.x;
+        myOrigin[1] = origin.y;
+        myOrigin[2] = origin.z;
+        myGeneration = nextGeneration();
+    }
+
+    /*
+     * Ring position of the given tick, counted from the last reset.
+     */
+    static int getSlot (const Ring& ring, uint64_t tick)
+    {
+        return int(tick % uint64_t(ring.length));
+    }
+
+    /*
+     * Builds this context's buffers from scratch.
+     */
+    void createBuffers (Context& context)
+    {
+        if (context.buffers[0] == 0)
+        {
+            glGenBuffers(3, context.buffers);
+        }
+        vector<GLuint> indices(myNumIndices);
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            const Ring& ring = myRings[kind];
+            size_t numBodies = ring.bodies.size();
+            for (size_t b = 0; b < numBodies; b++)
+            {
+                GLuint * out = &indices[ring.indexOffset + 2 * ring.length * b];
+                for (int i = 0; i < 2 * ring.length; i++)
+                {
+                    out[i] = GLuint(ring.vertexOffset + (i % ring.length) * numBodies + b);
+                }
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, context.buffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, myPositions.size() * sizeof(GLfloat),
+                     myPositions.empty() ? NULL : &myPositions[0], GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, context.buffers[1]);
+        glBufferData(GL_ARRAY_BUFFER, myColors.size() * sizeof(GLfloat),
+                     myColors.empty() ? NULL : &myColors[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.buffers[2]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+                     indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        context.generation = myGeneration;
+        context.numCopied = myNumTicks;
+    }
+
+    /*
+     * Copies the slices added since this context last drew: one small
+     * update per kind per tick.
+     */
+    void copyNewTicks (Context& context, DrawStats& stats)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, context.buffers[0]);
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            const Ring& ring = myRings[kind];
+            if (ring.length == 0)
+            {
+                continue;
+            }
+            // older ticks than a ring holds have been overwritten anyway
+            uint64_t first = max(context.numCopied, myNumTicks - min(myNumTicks, uint64_t(ring.length)));
+            size_t sliceSize = 3 * ring.bodies.size();
+            for (uint64_t tick = first; tick < myNumTicks; tick++)
+            {
+                size_t offset = 3 * ring.vertexOffset + getSlot(ring, tick) * sliceSize;
+                glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(GLfloat),
+                                sliceSize * sizeof(GLfloat), &myPositions[offset]);
+                stats.stateChanges++;
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        context.numCopied = myNumTicks;
+    }
+
+    Context& getContext ()
+    {
+        static thread_local Context theContext;
+        return theContext;
+    }
+
+  public:
+    // trail colors relative to the bodies'
+    static constexpr double TRAIL_BRIGHTNESS = 0.6;
+    // positions are rebased once the eye is this far from their origin
+    static constexpr double REBASE_DISTANCE = 4096;
+
+
+    TrailRenderer ()
+      : myNumVertices(0),
+        myNumIndices(0),
+        myNumTicks(0),
+        myGeneration(nextGeneration()),
+        isEnabled(false)
+    {
+        myLengths[KIND_SUN] = KindTraits<KIND_SUN>::TRAIL_LENGTH;
+        myLengths[KIND_PLANET] = KindTraits<KIND_PLANET>::TRAIL_LENGTH;
+        myLengths[KIND_MOON] = KindTraits<KIND_MOON>::TRAIL_LENGTH;
+        myOrigin[0] = myOrigin[1] = myOrigin[2] = 0;
+    }
+
+
+    /*
+     * Sorts the given catalog's bodies by kind and forgets every trail;
+     * call again whenever a catalog is loaded.
+     */
+    void setBodies (SolarSystem * system)
+    {
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            myRings[kind].bodies.clear();
+        }
+        for (int k = 0; k < system->getBodyCount(); k++)
+        {
+            myRings[system->getBody(k)->getKind()].bodies.push_back(k);
+        }
+        if (isEnabled)
+        {
+            layout();
+        }
+    }
+
+
+    /*
+     * Sets how many ticks the trails of the given kind show (0 for
+     * none), and starts every trail over.
+     */
+    void setLength (BodyKind kind, int ticks)
+    {
+        myLengths[kind] = max(0, ticks);
+        if (isEnabled)
+        {
+            layout();
+        }
+    }
+
+
+    int getLength (BodyKind kind) const
+    {
+        return myLengths[kind];
+    }
+
+
+    /*
+     * Starts or stops keeping trails; they start empty each time.
+     */
+    void toggle ()
+    {
+        isEnabled = ! isEnabled;
+        if (isEnabled)
+        {
+            layout();
+        }
+        else
+        {
+            myPositions.clear();
+            myColors.clear();
+        }
+    }
+
+
+    bool isShown () const
+    {
+        return isEnabled;
+    }
+
+
+    /*
+     * Adds every body's world position in state as the newest point of
+     * its trail, stored relative to an origin near the given eye.
+     */
+    void append (const BodyState& state, const Point3& eye = Point3())
+    {
+        TRACE_SCOPE("TrailRenderer::append");
+        if (! isEnabled)
+        {
+            return;
+        }
+        double dx = eye.x - myOrigin[0], dy = eye.y - myOrigin[1], dz = eye.z - myOrigin[2];
+        if (dx * dx + dy * dy + dz * dz > REBASE_DISTANCE * REBASE_DISTANCE)
+        {
+            rebase(eye);
+        }
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            const Ring& ring = myRings[kind];
+            if (ring.length == 0)
+            {
+                continue;
+            }
+            GLfloat * out = &myPositions[3 * (ring.vertexOffset +
+                                              getSlot(ring, myNumTicks) * ring.bodies.size())];
+            for (size_t b = 0; b < ring.bodies.size(); b++, out += 3)
+            {
+                int body = ring.bodies[b];
+                if (body < state.size())
+                {
+                    out[0] = GLfloat(state.x[body] - myOrigin[0]);
+                    out[1] = GLfloat(state.y[body] - myOrigin[1]);
+                    out[2] = GLfloat(state.z[body] - myOrigin[2]);
+                }
+            }
+        }
+        myNumTicks++;
+    }
+
+
+    /*
+     * Adds the trails to the report: the positions and colors kept
+     * here and, if the calling thread has drawn them, its context's
+     * copies in GPU buffers.
+     */
+    void reportMemory (MemoryReport& report)
+    {
+        size_t bytes = MemoryReport::bytesOf(myPositions) + MemoryReport::bytesOf(myColors);
+        long objects = 0;
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            bytes += MemoryReport::bytesOf(myRings[kind].bodies);
+            objects += long(myRings[kind].bodies.size());
+        }
+        const Context& context = getContext();
+        if (isEnabled && context.generation == myGeneration)
+        {
+            bytes += (myPositions.size() + myColors.size()) * sizeof(GLfloat) +
+                     myNumIndices * sizeof(GLuint) +
+                     MemoryReport::bytesOf(context.counts) + MemoryReport::bytesOf(context.starts);
+        }
+        report.add("trails", bytes, isEnabled ? objects : 0);
+    }
+
+
+    /*
+     * Draws every trail, oldest point first, in one call, with the
+     * world position eye at the modelview's origin.  Several threads
+     * may draw at once, each into its own context, but not while
+     * append() runs.
+     */
+    DrawStats draw (const Point3& eye = Point3())
+    {
+        TRACE_SCOPE("TrailRenderer::draw");
+        DrawStats stats;
+        if (! isEnabled || myNumTicks < 2 || myNumVertices == 0)
+        {
+            return stats;
+        }
+        Context& context = getContext();
+        if (context.generation != myGeneration)
+        {
+            createBuffers(context);
+            stats.stateChanges += 3;
+        }
+        else
+        {
+            copyNewTicks(context, stats);
+        }
+
+        // each trail's newest points, as a window of its indices
+        context.counts.clear();
+        context.starts.clear();
+        for (int kind = 0; kind < NUM_BODY_KINDS; kind++)
+        {
+            const Ring& ring = myRings[kind];
+            int count = int(min(myNumTicks, uint64_t(ring.length)));
+            if (count < 2)
+            {
+                continue;
+            }
+            int first = getSlot(ring, myNumTicks - count);
+            for (size_t b = 0; b < ring.bodies.size(); b++)
+            {
+                size_t index = ring.indexOffset + 2 * ring.length * b + first;
+                context.counts.push_back(count);
+                context.starts.push_back((const GLvoid *)(index * sizeof(GLuint)));
+            }
+        }
+        if (context.counts.empty())
+        {
+            return stats;
+        }
+
+        glPushMatrix();
+        glTranslated(myOrigin[0] - eye.x, myOrigin[1] - eye.y, myOrigin[2] - eye.z);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, context.buffers[0]);
+        glVertexPointer(3, GL_FLOAT, 0, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, context.buffers[1]);
+        glColorPointer(3, GL_FLOAT, 0, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.buffers[2]);
+        glMultiDrawElements(GL_LINE_STRIP, &context.counts[0], GL_UNSIGNED_INT,
+                            &context.starts[0], GLsizei(context.counts.size()));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glPopMatrix();
+        stats.drawCalls++;
+        stats.stateChanges += 12;
+        return stats;
+    }
+};
+
+#endif